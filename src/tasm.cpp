@@ -1459,10 +1459,15 @@ static inline void Pass2(const std::string &progname) {
       Error(std::format("ファイルが開けませんでした。 (パス: \"{}\")",
                         nameTableFileName));
     }
-    // 名前表を出力
+    // 名前表を出力（同じソースから常に同じ名前表になるよう、定義した行の順）
+    std::vector<std::pair<size_t, std::string>> labels;
     for (const auto &[label, addrAndLineNum] : Labels) {
+      labels.emplace_back(addrAndLineNum.second, label);
+    }
+    std::sort(labels.begin(), labels.end());
+    for (const auto &[lineNum, label] : labels) {
       ofs << std::format("{:<8} 0{:0>2X}H\n", label + ':',
-                         addrAndLineNum.first & 0xFF);
+                         Labels.at(label).first & 0xFF);
     }
   }
 }
@@ -0,0 +1,6124 @@
+// TeC のシミュレータ（tec と、tec2c が生成するシミュレータで共有する）
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cassert>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// x86-64 の機械語に変換して実行する方式 (--engine=jit) に対応するか
+#if defined(__x86_64__) && (defined(__linux__) || defined(__APPLE__))
+#include <sys/mman.h>
+#define TEC_JIT 1
+#else
+#define TEC_JIT 0
+#endif
+
+// 常駐してソケットで実行の要求を受け付ける方式 (--serve) に対応するか
+#if defined(__unix__) || defined(__APPLE__)
+#include <csignal>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#define TEC_SERVE 1
+#else
+#define TEC_SERVE 0
+#endif
+
+/// @brief エラーの種類
+enum class ErrorType : uint8_t {
+  /// @brief プログラムに問題がある。
+  Program,
+  /// @brief 判定用の入力に問題がある。
+  Input,
+  /// @brief バイナリに問題がある。
+  Binary,
+  /// @brief 名前表に問題がある。
+  NameTable,
+  /// @brief ジャッジシステムのバグ
+  Bug
+};
+
+/// @brief エラーメッセージを書き込む。
+/// @param err 書き込み先
+/// @param msg エラーメッセージ
+/// @param type エラーの種類
+static void WriteError(std::ostream &err, const std::string &msg,
+                       const ErrorType type) {
+  switch (type) {
+  case ErrorType::Binary:
+    err << "機械語: " << msg;
+    break;
+  case ErrorType::NameTable:
+    err << "名前表: " << msg;
+    break;
+  case ErrorType::Input:
+    err << "入力: " << msg;
+    break;
+  case ErrorType::Program:
+    err << "エラー: " << msg;
+    break;
+  case ErrorType::Bug:
+    err << "バグ: " << msg;
+    break;
+  }
+  err << '\n';
+}
+
+/// @brief 実行の制限に達したときの終了コード
+static constexpr int LimitExitCode = 2;
+
+/// @brief シミュレータの版（同じ入力に対する出力や終了コードを変えたら増やす）
+/// @note tecjudge の結果のキャッシュのキーに含める。
+static constexpr uint32_t SimulatorVersion = 1;
+
+/// @brief エラーメッセージを出力して終了する。
+/// @param msg エラーメッセージ
+/// @param type エラーの種類
+[[noreturn]] static void Error(const std::string &msg, const ErrorType type) {
+  WriteError(std::cerr, msg, type);
+  std::exit(1);
+}
+
+// バグ発生時用マクロ
+#define BUG(msg)                                                               \
+  Error(std::format("{}:{}: {}", __FILE__, __LINE__, msg), ErrorType::Bug)
+
+/// @brief 名前表
+using NameTable = std::unordered_map<std::string, uint8_t>;
+
+/// @brief レジスタ
+enum class Reg : uint8_t { G0, G1, G2, SP, PC };
+
+/// @brief 文字列をレジスタに変換する。
+[[nodiscard]] static inline std::optional<Reg> StrToReg(const std::string &s) {
+  std::optional<Reg> reg = std::nullopt;
+  if (s == "G0") {
+    reg = Reg::G0;
+  } else if (s == "G1") {
+    reg = Reg::G1;
+  } else if (s == "G2") {
+    reg = Reg::G2;
+  } else if (s == "SP") {
+    reg = Reg::SP;
+  } else if (s == "PC") {
+    reg = Reg::PC;
+  }
+  return reg;
+}
+
+/// @brief フラグ
+enum class Flg : uint8_t { C, S, Z };
+
+/// @brief 文字列をフラグに変換する。
+[[nodiscard]] static inline std::optional<Flg> StrToFlg(const std::string &s) {
+  std::optional<Flg> flg = std::nullopt;
+  if (s == "C") {
+    flg = Flg::C;
+  } else if (s == "S") {
+    flg = Flg::S;
+  } else if (s == "Z") {
+    flg = Flg::Z;
+  }
+  return flg;
+}
+
+/// @brief 命令の実行方式
+enum class Engine : uint8_t {
+  /// @brief 解読済み命令を1命令ずつ実行する。
+  Interp,
+  /// @brief 第1バイトごとに特殊化した命令をスレッデッドコードで実行する。
+  Threaded,
+  /// @brief 基本ブロック単位で変換した命令列を実行する。
+  Block,
+  /// @brief 何度も実行される基本ブロックを x86-64 の機械語に変換して実行する。
+  Jit,
+  /// @brief 1命令ずつ実行し始め、実行回数に応じて基本ブロック、機械語の順に
+  /// 変換して実行する。
+  Tiered,
+  /// @brief tec2c で事前に C++ に変換したプログラムを実行する
+  /// （tec2c が生成したシミュレータのみ）。
+  Aot
+};
+
+/// @brief 文字列を実行方式に変換する。
+[[nodiscard]] static inline std::optional<Engine>
+StrToEngine(const std::string &s) {
+  std::optional<Engine> engine = std::nullopt;
+  if (s == "interp") {
+    engine = Engine::Interp;
+  } else if (s == "threaded") {
+    engine = Engine::Threaded;
+  } else if (s == "block") {
+    engine = Engine::Block;
+  } else if (s == "jit") {
+    engine = Engine::Jit;
+  } else if (s == "tiered") {
+    engine = Engine::Tiered;
+  }
+  return engine;
+}
+
+/// @brief 実行の制限
+enum class Limit : uint8_t {
+  /// @brief 制限に達していない
+  None,
+  /// @brief ステート数の上限
+  States,
+  /// @brief 実行時間（実時間）の上限
+  Time
+};
+
+/// @brief 実行方式の段階ごとの統計
+struct TierStats {
+  /// @brief 1命令ずつ実行したステート数（Engine::Tiered のみ）
+  uint64_t stepStates;
+  /// @brief 基本ブロック単位で実行したステート数（Engine::Tiered のみ）
+  uint64_t blockStates;
+  /// @brief 機械語で実行したステート数（Engine::Tiered のみ）
+  uint64_t nativeStates;
+  /// @brief ROM のルーチンをまとめて実行したステート数（Engine::Tiered のみ）
+  uint64_t romStates;
+  /// @brief 基本ブロックに変換した回数
+  uint64_t translations;
+  /// @brief 基本ブロックに変換した命令数
+  uint64_t translatedInsts;
+  /// @brief 基本ブロックへの変換にかかった時間
+  std::chrono::nanoseconds translateTime;
+  /// @brief 機械語に変換した回数
+  uint64_t compilations;
+  /// @brief 機械語に変換した命令数
+  uint64_t compiledInsts;
+  /// @brief 機械語への変換にかかった時間
+  std::chrono::nanoseconds compileTime;
+  /// @brief 主記憶の書き換えで無効化した基本ブロックの数
+  uint64_t invalidations;
+};
+
+/// @brief TeC のレジスタ、主記憶、入出力の状態
+/// @note
+/// ゴールデンイメージからの復元、スナップショット、周期の検出は、
+/// この構造体を丸ごと扱う（TeC に状態を加えるときはここに加える）。
+/// 解読済み命令や機械語などのキャッシュ、実行の制限は含まない。
+struct TeCState {
+  // レジスタ
+  /// @brief G0
+  uint8_t g0;
+  /// @brief G1
+  uint8_t g1;
+  /// @brief G2
+  uint8_t g2;
+  /// @brief SP
+  uint8_t sp;
+  /// @brief PC
+  uint8_t pc;
+
+  // フラグ
+  /// @brief C, S, Z（最後にフラグを変えた演算の結果から必要なときに求める）
+  /// @note
+  /// FlgExplicit が 0 のとき、ビット8 が C、ビット7 が S で、
+  /// 下位8ビットが 0 なら Z が 1。
+  /// FlgExplicit が 1 のとき、ビット2, 1, 0 がそれぞれ C, S, Z。
+  uint16_t flg;
+  /// @brief 割り込み許可
+  bool intEna : 1;
+  /// @brief 実行フラグ
+  bool run : 1;
+  /// @brief エラーフラグ
+  bool err : 1;
+
+  /// @brief 主記憶
+  std::array<uint8_t, 256> mm;
+
+  // 入出力
+  /// @brief データスイッチ
+  uint8_t dataSW;
+  /// @brief シリアル入力レジスタ
+  uint8_t rxReg;
+  /// @brief シリアル出力レジスタ
+  uint8_t txReg;
+  /// @brief タイマカウンタ
+  uint8_t tmrCnt;
+  /// @brief タイマ周期レジスタ
+  uint8_t tmrPeriod;
+  /// @brief パラレル入力レジスタ
+  uint8_t parallelIn;
+  /// @brief パラレル出力レジスタ
+  uint8_t parallelOut;
+  /// @brief パラレル出力レジスタ（拡張）
+  uint8_t extParallelOut : 4;
+  /// @brief アナログ入力レジスタ
+  std::array<uint8_t, 4> adcChs;
+  /// @brief ブザー
+  bool buz : 1;
+  /// @brief スピーカ
+  bool spk : 1;
+  /// @brief タイマ有効フラグ
+  bool tmrEna : 1;
+  /// @brief 拡張パラレル出力有効フラグ
+  bool extParallelOutEna : 1;
+  /// @brief タイマ経過フラグ
+  bool tmrElapsed : 1;
+  /// @brief 割り込み要求（INT0 ~ INT3 がビット0 ~ 3）
+  /// @note
+  /// INT0: タイマ割り込みフラグ, INT1: シリアル入力受信バッファ満フラグ,
+  /// INT2: シリアル出力送信バッファ空フラグ, INT3: コンソール割り込みフラグ
+  uint8_t intReq;
+  /// @brief 有効な割り込み（INT0 ~ INT3 がビット0 ~ 3）
+  uint8_t intMask;
+  /// @brief タイマを動作させるためのカウンタ
+  uint16_t tmrClkCnt;
+  /// @brief 実行したステート数の合計
+  uint64_t totalStates;
+  /// @brief FIFO が満杯または空でシリアル入出力の受け渡しが止まっているか
+  bool serialPending;
+
+  /// @brief flg がフラグの値そのものを表していることを示すビット
+  static constexpr uint16_t FlgExplicit = 0x8000;
+
+  /// @brief C フラグの値を求める。
+  bool flgC() const noexcept {
+    return (flg & ((flg & FlgExplicit) != 0 ? 0x04 : 0x100)) != 0;
+  }
+
+  /// @brief S フラグの値を求める。
+  bool flgS() const noexcept {
+    return (flg & ((flg & FlgExplicit) != 0 ? 0x02 : 0x80)) != 0;
+  }
+
+  /// @brief Z フラグの値を求める。
+  bool flgZ() const noexcept {
+    return (flg & FlgExplicit) != 0 ? (flg & 0x01) != 0 : (flg & 0xFF) == 0;
+  }
+
+  /// @brief フラグの値を設定する。
+  void setFlgs(const bool c, const bool s, const bool z) noexcept {
+    flg = static_cast<uint16_t>(FlgExplicit | (c ? 0x04 : 0x00) |
+                                (s ? 0x02 : 0x00) | (z ? 0x01 : 0x00));
+  }
+
+  bool operator==(const TeCState &) const = default;
+};
+
+static_assert(std::is_trivially_copyable_v<TeCState>);
+
+/// @brief TeC の状態のスナップショット（TeC::snapshot() を参照）
+struct TeCSnapshot {
+  /// @brief レジスタ、主記憶、入出力の状態
+  TeCState state;
+  /// @brief シリアル入力 FIFO の内容
+  std::vector<uint8_t> serialIn;
+  /// @brief シリアル出力 FIFO の内容
+  std::vector<uint8_t> serialOut;
+};
+
+class TeC;
+
+/// @brief tec2c で C++ に変換したプログラム（tec2c が生成するコードで定義する）
+/// @note TeC の内部を直接操作するため、TeC の friend とする。
+struct AotProgram;
+
+/// @brief tec2c で C++ に変換したプログラムの情報
+struct AotInfo {
+  /// @brief 実行関数（TeC::clock() と同様に、指定したステート数の命令を実行する）
+  uint64_t (*clock)(TeC &tec, uint64_t maxStates);
+  /// @brief 変換した機械語の開始アドレス
+  uint8_t start;
+  /// @brief 変換した機械語のサイズ
+  uint8_t size;
+  /// @brief 変換した機械語
+  const uint8_t *values;
+  /// @brief 番地ごとの、命令として変換したか（ROM 領域を除く）
+  std::array<bool, 256> cover;
+};
+
+/// @brief 文字列を10進数の整数に変換する。
+[[nodiscard]] static inline std::optional<uint64_t>
+StrToUInt64(const std::string &s) {
+  uint64_t val = 0;
+  const auto [ptr, ec] = std::from_chars(s.data(), s.data() + s.size(), val);
+  if (s.empty() || ec != std::errc() || ptr != s.data() + s.size()) {
+    return std::nullopt;
+  }
+  return val;
+}
+
+// 命令の第1バイト (0x00 ~ 0xFF) ごとに X(第1バイト) を展開する。
+#define TEC_FOR_EACH_INST16(X, h)                                              \
+  X(0x##h##0) X(0x##h##1) X(0x##h##2) X(0x##h##3) X(0x##h##4) X(0x##h##5)      \
+  X(0x##h##6) X(0x##h##7) X(0x##h##8) X(0x##h##9) X(0x##h##A) X(0x##h##B)      \
+  X(0x##h##C) X(0x##h##D) X(0x##h##E) X(0x##h##F)
+#define TEC_FOR_EACH_INST(X)                                                   \
+  TEC_FOR_EACH_INST16(X, 0) TEC_FOR_EACH_INST16(X, 1)                          \
+  TEC_FOR_EACH_INST16(X, 2) TEC_FOR_EACH_INST16(X, 3)                          \
+  TEC_FOR_EACH_INST16(X, 4) TEC_FOR_EACH_INST16(X, 5)                          \
+  TEC_FOR_EACH_INST16(X, 6) TEC_FOR_EACH_INST16(X, 7)                          \
+  TEC_FOR_EACH_INST16(X, 8) TEC_FOR_EACH_INST16(X, 9)                          \
+  TEC_FOR_EACH_INST16(X, A) TEC_FOR_EACH_INST16(X, B)                          \
+  TEC_FOR_EACH_INST16(X, C) TEC_FOR_EACH_INST16(X, D)                          \
+  TEC_FOR_EACH_INST16(X, E) TEC_FOR_EACH_INST16(X, F)
+
+#if TEC_JIT
+/// @brief 実行可能な機械語を置くメモリ領域
+/// @note 書き込む間だけ書き込み可能にし、それ以外は読み出しと実行のみ許可する。
+class CodeBuffer {
+public:
+  /// @param capacity 領域のバイト数
+  explicit CodeBuffer(const size_t capacity) noexcept
+      : m_base(Map(capacity)), m_capacity(m_base != nullptr ? capacity : 0),
+        m_used(0) {}
+
+  CodeBuffer(const CodeBuffer &) = delete;
+  CodeBuffer &operator=(const CodeBuffer &) = delete;
+
+  ~CodeBuffer() {
+    if (m_base != nullptr) {
+      munmap(m_base, m_capacity);
+    }
+  }
+
+  /// @brief 機械語を追加する。
+  /// @param code 機械語
+  /// @return 追加した機械語の先頭アドレス（領域が足りなければ nullptr）
+  const void *add(const std::vector<uint8_t> &code) noexcept {
+    if (m_capacity - m_used < code.size() ||
+        mprotect(m_base, m_capacity, PROT_READ | PROT_WRITE) != 0) {
+      return nullptr;
+    }
+    uint8_t *const dst = m_base + m_used;
+    std::memcpy(dst, code.data(), code.size());
+    if (mprotect(m_base, m_capacity, PROT_READ | PROT_EXEC) != 0) {
+      return nullptr;
+    }
+    m_used = std::min(m_capacity, (m_used + code.size() + 15) & ~size_t{15});
+    return dst;
+  }
+
+  /// @brief 追加した機械語を全て破棄する。
+  void clear() noexcept { m_used = 0; }
+
+private:
+  /// @brief 先頭アドレス（確保できなければ nullptr）
+  uint8_t *m_base;
+  /// @brief 領域のバイト数
+  size_t m_capacity;
+  /// @brief 使用済みのバイト数
+  size_t m_used;
+
+  /// @brief 領域を確保する。
+  static uint8_t *Map(const size_t capacity) noexcept {
+    void *const base = mmap(nullptr, capacity, PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    return base == MAP_FAILED ? nullptr : static_cast<uint8_t *>(base);
+  }
+};
+
+/// @brief x86-64 の機械語を組み立てる。
+/// @note
+/// 8ビットのレジスタ操作には常に REX プレフィクスを付け、
+/// レジスタ番号 (0 ~ 15) をそのまま使えるようにする。
+class X64Emitter {
+public:
+  /// @brief 汎用レジスタの番号
+  enum Reg : uint8_t {
+    RAX = 0,
+    RCX = 1,
+    RDX = 2,
+    RBX = 3,
+    RSP = 4,
+    RBP = 5,
+    RSI = 6,
+    RDI = 7,
+    R12 = 12,
+    R13 = 13,
+    R14 = 14,
+    R15 = 15
+  };
+
+  /// @brief 条件コード
+  enum Cond : uint8_t { B = 0x2, E = 0x4, NE = 0x5, S = 0x8 };
+
+  /// @brief 組み立てた機械語
+  const std::vector<uint8_t> &code() const noexcept { return m_code; }
+
+  /// @brief 組み立てた機械語のバイト数
+  size_t size() const noexcept { return m_code.size(); }
+
+  /// @brief 別に組み立てた機械語を後ろに付け加える。
+  void append(const X64Emitter &other) {
+    m_code.insert(m_code.end(), other.m_code.begin(), other.m_code.end());
+  }
+
+  /// @brief mov r8, imm8
+  void movRI8(const uint8_t r, const uint8_t imm) {
+    rex(false, 0, 0, r);
+    emit(0xB0 + (r & 7));
+    emit(imm);
+  }
+
+  /// @brief mov r8, r8
+  void movRR8(const uint8_t dst, const uint8_t src) {
+    rex(false, src, 0, dst);
+    emit(0x88);
+    modrm(3, src, dst);
+  }
+
+  /// @brief movzx r32, r8
+  void movzxRR8(const uint8_t dst, const uint8_t src) {
+    rex(false, dst, 0, src);
+    emit(0x0F);
+    emit(0xB6);
+    modrm(3, dst, src);
+  }
+
+  /// @brief mov r32, imm32 (RAX ~ RDI のみ)
+  void movRI32(const uint8_t r, const uint32_t imm) {
+    emit(0xB8 + (r & 7));
+    imm32(imm);
+  }
+
+  /// @brief mov r32, r32 (RAX ~ RDI のみ)
+  void movRR32(const uint8_t dst, const uint8_t src) {
+    emit(0x89);
+    modrm(3, src, dst);
+  }
+
+  /// @brief mov r64, r64
+  void movRR64(const uint8_t dst, const uint8_t src) {
+    rex(true, src, 0, dst);
+    emit(0x89);
+    modrm(3, src, dst);
+  }
+
+  /// @brief mov r64, imm64
+  void movRI64(const uint8_t r, const uint64_t imm) {
+    rex(true, 0, 0, r);
+    emit(0xB8 + (r & 7));
+    imm32(static_cast<uint32_t>(imm));
+    imm32(static_cast<uint32_t>(imm >> 32));
+  }
+
+  /// @brief mov r8, [base + index]（base は RBP, R13 以外）
+  void loadIdx8(const uint8_t dst, const uint8_t base, const uint8_t index) {
+    rex(false, dst, index, base);
+    emit(0x8A);
+    modrm(0, dst, 4);
+    emit(static_cast<uint8_t>(((index & 7) << 3) | (base & 7)));
+  }
+
+  /// @brief mov r8, [rbp + disp8]
+  void loadRbp8(const uint8_t dst, const uint8_t disp) {
+    rex(false, dst, 0, RBP);
+    emit(0x8A);
+    modrm(1, dst, RBP);
+    emit(disp);
+  }
+
+  /// @brief mov r64, [rbp + disp8]
+  void loadRbp64(const uint8_t dst, const uint8_t disp) {
+    rex(true, dst, 0, RBP);
+    emit(0x8B);
+    modrm(1, dst, RBP);
+    emit(disp);
+  }
+
+  /// @brief mov [rbp + disp8], r8
+  void storeRbp8(const uint8_t disp, const uint8_t src) {
+    rex(false, src, 0, RBP);
+    emit(0x88);
+    modrm(1, src, RBP);
+    emit(disp);
+  }
+
+  /// @brief mov byte [rbp + disp8], imm8
+  void storeRbpI8(const uint8_t disp, const uint8_t imm) {
+    emit(0xC6);
+    modrm(1, 0, RBP);
+    emit(disp);
+    emit(imm);
+  }
+
+  /// @brief cmp byte [rbp + disp8], imm8
+  void cmpRbpI8(const uint8_t disp, const uint8_t imm) {
+    emit(0x80);
+    modrm(1, 7, RBP);
+    emit(disp);
+    emit(imm);
+  }
+
+  /// @brief setcc byte [rbp + disp8]
+  void setccRbp(const Cond cc, const uint8_t disp) {
+    emit(0x0F);
+    emit(0x90 | cc);
+    modrm(1, 0, RBP);
+    emit(disp);
+  }
+
+  /// @brief 8ビットの演算 r8, imm8（ext は 0x80 命令の拡張コード）
+  void aluRI8(const uint8_t ext, const uint8_t r, const uint8_t imm) {
+    rex(false, 0, 0, r);
+    emit(0x80);
+    modrm(3, ext, r);
+    emit(imm);
+  }
+
+  /// @brief 8ビットの演算 r8, r8（opcode は r/m8, r8 形式の命令コード）
+  void aluRR8(const uint8_t opcode, const uint8_t dst, const uint8_t src) {
+    rex(false, src, 0, dst);
+    emit(opcode);
+    modrm(3, src, dst);
+  }
+
+  /// @brief 8ビットの1ビットシフト（ext は 0xD0 命令の拡張コード）
+  void shiftR8(const uint8_t ext, const uint8_t r) {
+    rex(false, 0, 0, r);
+    emit(0xD0);
+    modrm(3, ext, r);
+  }
+
+  /// @brief inc r8
+  void incR8(const uint8_t r) {
+    rex(false, 0, 0, r);
+    emit(0xFE);
+    modrm(3, 0, r);
+  }
+
+  /// @brief dec r8
+  void decR8(const uint8_t r) {
+    rex(false, 0, 0, r);
+    emit(0xFE);
+    modrm(3, 1, r);
+  }
+
+  /// @brief test r8, r8
+  void testRR8(const uint8_t a, const uint8_t b) {
+    rex(false, b, 0, a);
+    emit(0x84);
+    modrm(3, b, a);
+  }
+
+  /// @brief jcc rel8
+  void jcc8(const Cond cc, const size_t rel) {
+    assert(rel <= 0x7F);
+    emit(0x70 | cc);
+    emit(static_cast<uint8_t>(rel));
+  }
+
+  /// @brief add r64, imm8
+  void addRI8x64(const uint8_t r, const uint8_t imm) {
+    rex(true, 0, 0, r);
+    emit(0x83);
+    modrm(3, 0, r);
+    emit(imm);
+  }
+
+  /// @brief sub r64, imm8
+  void subRI8x64(const uint8_t r, const uint8_t imm) {
+    rex(true, 0, 0, r);
+    emit(0x83);
+    modrm(3, 5, r);
+    emit(imm);
+  }
+
+  /// @brief call r64 (RAX ~ RDI のみ)
+  void callR(const uint8_t r) {
+    emit(0xFF);
+    modrm(3, 2, r);
+  }
+
+  /// @brief push r64
+  void push(const uint8_t r) {
+    if (8 <= r) {
+      emit(0x41);
+    }
+    emit(0x50 + (r & 7));
+  }
+
+  /// @brief pop r64
+  void pop(const uint8_t r) {
+    if (8 <= r) {
+      emit(0x41);
+    }
+    emit(0x58 + (r & 7));
+  }
+
+  /// @brief ret
+  void ret() { emit(0xC3); }
+
+private:
+  /// @brief 機械語
+  std::vector<uint8_t> m_code;
+
+  void emit(const int b) { m_code.push_back(static_cast<uint8_t>(b)); }
+
+  void imm32(const uint32_t v) {
+    for (int i = 0; i < 4; ++i) {
+      emit((v >> (8 * i)) & 0xFF);
+    }
+  }
+
+  void rex(const bool w, const uint8_t reg, const uint8_t index,
+           const uint8_t base) {
+    emit(0x40 | (w ? 0x08 : 0x00) | ((reg >> 3) << 2) | ((index >> 3) << 1) |
+         (base >> 3));
+  }
+
+  void modrm(const uint8_t mod, const uint8_t reg, const uint8_t rm) {
+    emit((mod << 6) | ((reg & 7) << 3) | (rm & 7));
+  }
+};
+#endif
+
+/// @brief 容量が固定のバイト列のリングバッファ
+/// @tparam Capacity 容量（2の累乗）
+template <size_t Capacity> class RingBuffer {
+  static_assert(std::has_single_bit(Capacity));
+
+public:
+  RingBuffer() : m_buf(), m_head(0), m_tail(0) {}
+
+  /// @brief 格納しているバイト数を取得する。
+  size_t size() const noexcept { return m_tail - m_head; }
+
+  /// @brief 空か
+  bool empty() const noexcept { return m_head == m_tail; }
+
+  /// @brief 満杯か
+  bool full() const noexcept { return size() == Capacity; }
+
+  /// @brief 末尾に1バイト追加する（満杯でないこと）。
+  void push(const uint8_t val) noexcept {
+    assert(not full());
+    m_buf[m_tail++ & (Capacity - 1)] = val;
+  }
+
+  /// @brief 先頭から1バイト取り出す（空でないこと）。
+  uint8_t pop() noexcept {
+    assert(not empty());
+    return m_buf[m_head++ & (Capacity - 1)];
+  }
+
+  /// @brief 末尾に入るだけ追加する。
+  /// @param data 追加するバイト列
+  /// @param size バイト数
+  /// @return 追加したバイト数
+  size_t push(const uint8_t *data, const size_t size) noexcept {
+    const size_t n = std::min(size, Capacity - this->size());
+    for (size_t i = 0; i < n;) {
+      // 配列の終わりで折り返すまでをまとめて複写する
+      const size_t pos = (m_tail + i) & (Capacity - 1);
+      const size_t len = std::min(n - i, Capacity - pos);
+      std::memcpy(&m_buf[pos], data + i, len);
+      i += len;
+    }
+    m_tail += n;
+    return n;
+  }
+
+  /// @brief 空にする。
+  void clear() noexcept { m_head = m_tail = 0; }
+
+  /// @brief 先頭から取り出せるだけ、取り出さずに複写する。
+  /// @param data 複写先
+  /// @param size 複写先のバイト数
+  /// @return 複写したバイト数
+  size_t peek(uint8_t *data, const size_t size) const noexcept {
+    const size_t n = std::min(size, this->size());
+    for (size_t i = 0; i < n;) {
+      const size_t pos = (m_head + i) & (Capacity - 1);
+      const size_t len = std::min(n - i, Capacity - pos);
+      std::memcpy(data + i, &m_buf[pos], len);
+      i += len;
+    }
+    return n;
+  }
+
+  /// @brief 先頭から取り出せるだけ取り出す。
+  /// @param data 取り出したバイト列の格納先
+  /// @param size 格納先のバイト数
+  /// @return 取り出したバイト数
+  size_t pop(uint8_t *data, const size_t size) noexcept {
+    const size_t n = peek(data, size);
+    m_head += n;
+    return n;
+  }
+
+private:
+  std::array<uint8_t, Capacity> m_buf;
+  /// @brief 先頭の位置（容量で割った余りが添字）
+  size_t m_head;
+  /// @brief 末尾の次の位置（容量で割った余りが添字）
+  size_t m_tail;
+};
+
+/// @brief 判定用の簡易TeCシミュレータ
+/// @note 複数のインスタンスを並べて使うため、キャッシュラインの境界に揃える。
+class alignas(64) TeC {
+  friend struct AotProgram;
+
+public:
+  TeC() noexcept
+      : m_state{.g0 = 0x00,
+                .g1 = 0x00,
+                .g2 = 0x00,
+                .sp = 0x00,
+                .pc = 0x00,
+                .flg = TeCState::FlgExplicit,
+                .intEna = false,
+                .run = false,
+                .err = false,
+                .mm = {
+                    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // 0x00
+                    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // 0x08
+                    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // 0x10
+                    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // 0x18
+                    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // 0x20
+                    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // 0x28
+                    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // 0x30
+                    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // 0x38
+                    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // 0x40
+                    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // 0x48
+                    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // 0x50
+                    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // 0x58
+                    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // 0x60
+                    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // 0x68
+                    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // 0x70
+                    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // 0x78
+                    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // 0x80
+                    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // 0x88
+                    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // 0x90
+                    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // 0x98
+                    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // 0xA0
+                    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // 0xA8
+                    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // 0xB0
+                    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // 0xB8
+                    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // 0xC0
+                    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // 0xC8
+                    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // 0xD0
+                    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // 0xD8
+                    0x1F, 0xDC, 0xB0, 0xF6, 0xD0, 0xD6, 0xB0, 0xF6, // 0xE0
+                    0xD0, 0xDA, 0xA4, 0xFF, 0xB0, 0xF6, 0x21, 0x00, // 0xE8
+                    0x37, 0x01, 0x4B, 0x01, 0xA0, 0xEA, 0xC0, 0x03, // 0xF0
+                    0x63, 0x40, 0xA4, 0xF6, 0xC0, 0x02, 0xEC, 0xFF  // 0xF8
+                },
+                .dataSW = 0x00,
+                .rxReg = 0x00,
+                .txReg = 0x00,
+                .tmrCnt = 0x00,
+                .tmrPeriod = 74,
+                .parallelIn = 0x00,
+                .parallelOut = 0x00,
+                .extParallelOut = 0x0,
+                .adcChs = {0x00, 0x00, 0x00, 0x00},
+                .buz = false,
+                .spk = false,
+                .tmrEna = false,
+                .extParallelOutEna = false,
+                .tmrElapsed = false,
+                .intReq = Int2Bit,
+                .intMask = 0x00,
+                .tmrClkCnt = 0,
+                .totalStates = 0,
+                .serialPending = false},
+        m_ctrl{.tmrCtrlWrites = 0,
+               .loopPeriod = 0,
+               .stateLimit = UINT64_MAX,
+               .deadline = std::chrono::steady_clock::time_point::max(),
+               .deadlineCountdown = 0,
+               .limit = Limit::None,
+               .engine = Engine::Tiered,
+               .horizon = 0,
+               .sliceEnd = 0,
+               .slices = 0,
+               .sampleSlices = 1,
+               .waitRxEmpty = false,
+               .serialTransfers = 0,
+               .stats = {},
+               .aotClock = nullptr,
+               .aotCover = {},
+               .aotModified = false},
+        m_decoded(), m_fusedCover(), m_blocks(), m_blockCover(), m_serialIn(),
+        m_serialOut() {}
+
+  /// @brief 動作周波数 2.4576 MHz
+  static constexpr uint64_t StatesPerSec = 2'457'600;
+
+  /// @brief シリアル入出力の速度 9600 bit/s
+  static constexpr uint64_t SIOBitPerSec = 9'600;
+
+  /// @brief ROM領域（IPL）の開始アドレス
+  static constexpr uint8_t RomStartAddr = 0xE0;
+
+  /// @brief ROM の1文字入力ルーチン（READ）の入口
+  static constexpr uint8_t RomReadAddr = 0xF6;
+
+  /// @brief 実行を開始する。
+  void run() noexcept { m_state.run = true; }
+
+  /// @brief 実行を停止する。
+  void stop() noexcept { m_state.run = false; }
+
+  /// @brief 初期化する。
+  void reset() noexcept {
+    m_state.run = false;
+    m_state.err = false;
+    m_state.g0 = 0;
+    m_state.g1 = 0;
+    m_state.g2 = 0;
+    m_state.sp = 0;
+    m_state.pc = 0;
+    m_state.intReq =
+        static_cast<uint8_t>((m_state.intReq | Int2Bit) & ~Int1Bit);
+    m_state.intMask =
+        static_cast<uint8_t>(m_state.intMask & ~(Int1Bit | Int2Bit));
+  }
+
+  /// @brief レジスタの値を設定する。
+  /// @param reg レジスタ
+  /// @param val 値
+  void setReg(const Reg reg, const uint8_t val) noexcept {
+    switch (reg) {
+    case Reg::G0:
+      m_state.g0 = val;
+      break;
+    case Reg::G1:
+      m_state.g1 = val;
+      break;
+    case Reg::G2:
+      m_state.g2 = val;
+      break;
+    case Reg::SP:
+      m_state.sp = val;
+      break;
+    case Reg::PC:
+      m_state.pc = val;
+      break;
+    default:
+      BUG("TeC::setReg(Reg, uint8_t) noexcept");
+      break;
+    }
+  }
+
+  /// @brief フラグの値を設定する。
+  /// @param flg フラグ
+  /// @param val 値
+  void setFlg(const Flg flg, const bool val) noexcept {
+    switch (flg) {
+    case Flg::C:
+      setFlgs(val, flgS(), flgZ());
+      break;
+    case Flg::S:
+      setFlgs(flgC(), val, flgZ());
+      break;
+    case Flg::Z:
+      setFlgs(flgC(), flgS(), val);
+      break;
+    default:
+      BUG("TeC::setFlg(Flg, bool) noexcept");
+      break;
+    }
+  }
+
+  /// @brief 主記憶の値を設定する。
+  /// @param addr アドレス
+  /// @param val 値
+  void setMM(const uint8_t addr, const uint8_t val) noexcept {
+    writeMem(addr, val);
+  }
+
+  /// @brief データスイッチの値を設定する。
+  /// @param val 値
+  void setDataSW(const uint8_t val) noexcept { m_state.dataSW = val; }
+
+  /// @brief レジスタの値を取得する。
+  /// @param reg レジスタ
+  /// @return 値
+  uint8_t getReg(const Reg reg) const noexcept {
+    uint8_t val = 0x00;
+    switch (reg) {
+    case Reg::G0:
+      val = m_state.g0;
+      break;
+    case Reg::G1:
+      val = m_state.g1;
+      break;
+    case Reg::G2:
+      val = m_state.g2;
+      break;
+    case Reg::SP:
+      val = m_state.sp;
+      break;
+    case Reg::PC:
+      val = m_state.pc;
+      break;
+    default:
+      BUG("TeC::getReg(Reg) const noexcept");
+      break;
+    }
+    return val;
+  }
+
+  /// @brief ブザーの値を取得する。
+  /// @return ブザーの値
+  bool getBuz() const noexcept { return m_state.buz; }
+
+  /// @brief スピーカの値を取得する。
+  /// @return スピーカの値
+  bool getSpk() const noexcept { return m_state.spk; }
+
+  /// @brief フラグの値を取得する。
+  /// @param flg フラグ
+  /// @return 値
+  bool getFlg(const Flg flg) const noexcept {
+    bool val = false;
+    switch (flg) {
+    case Flg::C:
+      val = flgC();
+      break;
+    case Flg::S:
+      val = flgS();
+      break;
+    case Flg::Z:
+      val = flgZ();
+      break;
+    default:
+      BUG("TeC::getFlg(Flg) const noexcept");
+      break;
+    }
+    return val;
+  }
+
+  /// @brief 主記憶の値を取得する。
+  /// @param addr アドレス
+  /// @return 値
+  uint8_t getMM(const uint8_t addr) const noexcept { return m_state.mm[addr]; }
+
+  /// @brief 実行フラグの値を取得する。
+  /// @return 実行フラグの値
+  bool isRunning() const noexcept { return m_state.run; }
+
+  /// @brief エラーフラグの値を取得する。
+  /// @return エラーフラグの値
+  bool isError() const noexcept { return m_state.err; }
+
+  /// @brief SIOで1バイト送信するのに必要なステート数
+  static constexpr uint64_t SerialUnitStates =
+      StatesPerSec / (SIOBitPerSec * 8);
+
+  /// @brief 指定したステート数の命令を実行する。
+  /// @param maxStates
+  /// 実行する最大ステート数（デフォルトはシリアル入出力の１バイト分に相当）
+  /// @note
+  /// 指定したステート数経過時に命令実行の途中であれば最大ステート数を超過する。
+  /// @note
+  /// シリアル入出力の1バイト分の区切りで受け渡しが必要になったとき、
+  /// または m_ctrl.sampleSlices 個目の区切りでは、最大ステート数に達する前に戻る
+  /// （isClockDone() を参照）。
+  /// @note
+  /// 実行の制限に達していれば何も実行しない（exceededLimit() を参照）。
+  /// 制限は呼び出しごとに確かめるので、命令ごとの負担はない。
+  uint64_t clock(uint64_t maxStates = SerialUnitStates) {
+    if (m_ctrl.limit != Limit::None) {
+      return 0;
+    }
+    // 実時間は DeadlineCheckUnits 回の呼び出しごとに確かめる
+    if (m_ctrl.deadlineCountdown == 0) {
+      m_ctrl.deadlineCountdown = DeadlineCheckUnits;
+      if (m_ctrl.deadline <= std::chrono::steady_clock::now()) {
+        m_ctrl.limit = Limit::Time;
+        return 0;
+      }
+    }
+    --m_ctrl.deadlineCountdown;
+    maxStates = std::min(maxStates, remainingStates());
+    if (maxStates == 0) {
+      m_ctrl.limit = Limit::States;
+      return 0;
+    }
+    uint64_t states = 0;
+    m_state.run = true;
+    m_ctrl.sliceEnd = SerialUnitStates;
+    m_ctrl.slices = 0;
+    switch (m_ctrl.engine) {
+    case Engine::Aot:
+      if (not m_ctrl.aotModified) {
+        states = m_ctrl.aotClock(*this, maxStates);
+        break;
+      }
+      // 変換したプログラムが書き換えられていれば、インタプリタで実行する
+      [[fallthrough]];
+    case Engine::Interp:
+      beginHorizon(states, maxStates);
+      states = resumeInterp(states, maxStates);
+      break;
+    case Engine::Threaded:
+      states = clockThreaded(maxStates);
+      break;
+    case Engine::Block:
+      states = clockBlock(maxStates);
+      break;
+    case Engine::Jit:
+      states = clockJit(maxStates);
+      break;
+    case Engine::Tiered:
+      states = clockTiered(maxStates);
+      break;
+    default:
+      BUG("TeC::clock(uint64_t)");
+      break;
+    }
+    m_state.totalStates += states;
+    pollSerial();
+    return states;
+  }
+
+  /// @brief 実行できるステート数の合計の上限を設定する。
+  /// @param limit これまでに実行したステート数を含む上限
+  void setStateLimit(const uint64_t limit) noexcept {
+    m_ctrl.stateLimit = limit;
+  }
+
+  /// @brief 実行できるステート数の合計の上限を取得する。
+  /// @return これまでに実行したステート数を含む上限
+  uint64_t getStateLimit() const noexcept { return m_ctrl.stateLimit; }
+
+  /// @brief 実行を打ち切る時刻を設定する。
+  /// @param deadline 時刻
+  void
+  setDeadline(const std::chrono::steady_clock::time_point deadline) noexcept {
+    m_ctrl.deadline = deadline;
+    m_ctrl.deadlineCountdown = 0;
+  }
+
+  /// @brief これまでに実行したステート数の合計を取得する。
+  /// @return ステート数
+  uint64_t getTotalStates() const noexcept { return m_state.totalStates; }
+
+  /// @brief 達した実行の制限を取得する。
+  /// @return 実行の制限（達していなければ Limit::None）
+  Limit exceededLimit() const noexcept { return m_ctrl.limit; }
+
+  /// @brief 入出力が必要になるまで、シリアル入出力の1バイト分ずつ命令を実行する。
+  /// @param maxStates 実行する最大ステート数（UINT64_MAX なら無制限）
+  /// @param waitRxEmpty
+  /// シリアル入力 FIFO と受信バッファが空になったら戻るか（FIFO に書き込む
+  /// 入力が残っている場合や、入力が全て受け取られるまで待つ場合に指定する）
+  /// @return 実行したステート数
+  /// @note
+  /// clock(残りのステート数) を繰り返し、停止・エラーのとき、または
+  /// FIFO が満杯か空でシリアル入出力の受け渡しが止まったときに戻る
+  /// （FIFO を読み書きしてから resumeSerial() を呼び出すこと）。
+  /// 1バイト分ごとに戻って入出力を確認する場合と同じ結果になる。
+  /// @note
+  /// 入出力装置を含む全ての状態が周期的に繰り返される場合（入出力待ちのループ）は、
+  /// 次にタイマが進むか最大ステート数に達する直前まで、周期単位で時間を進める。
+  /// @note
+  /// 最大ステート数が無制限で、タイマを含む全ての状態が繰り返される場合は、
+  /// 入出力なしに永久にループしているので、その周期を記録して戻る
+  /// （isLooping() を参照）。
+  uint64_t clockUntilIO(const uint64_t maxStates, const bool waitRxEmpty) {
+    uint64_t states = 0;
+    m_ctrl.loopPeriod = 0;
+    m_ctrl.waitRxEmpty = waitRxEmpty;
+    m_state.serialPending = false;
+    // Brent の方法で周期を検出する
+    State saved = state();
+    uint64_t savedStates = 0;
+    uint16_t savedTmrClkCnt = m_state.tmrClkCnt;
+    uint32_t savedTmrCtrlWrites = m_ctrl.tmrCtrlWrites;
+    size_t power = 1;
+    size_t lambda = 0;
+    // 周期単位で時間を進めた直後の状態についても同様に周期を検出する
+    // （タイマ割り込みを挟む長い周期を検出するため）
+    State landmark = saved;
+    uint64_t landmarkStates = 0;
+    uint16_t landmarkTmrClkCnt = m_state.tmrClkCnt;
+    size_t landmarkPower = 1;
+    size_t landmarkLambda = 0;
+    do {
+      // 周期が見つかった直後は細かく、見つからない間は粗く状態を調べる
+      // （どの時点の状態を比べても、一致すれば周期は正しい）
+      m_ctrl.sampleSlices =
+          static_cast<uint32_t>(std::min<size_t>(power, MaxSampleSlices));
+      states += clock(maxStates - states);
+      if (maxStates <= states || not m_state.run || m_state.err ||
+          m_ctrl.limit != Limit::None || m_state.serialPending) {
+        break;
+      }
+      ++lambda;
+      if (m_state.pc == saved.tec.pc && m_state.g0 == saved.tec.g0 &&
+          m_state.g1 == saved.tec.g1 && m_state.g2 == saved.tec.g2 &&
+          m_state.sp == saved.tec.sp && state() == saved) {
+        const uint64_t period = states - savedStates;
+        if (m_state.tmrClkCnt == savedTmrClkCnt ||
+            (not m_state.tmrEna &&
+             m_ctrl.tmrCtrlWrites == savedTmrCtrlWrites)) {
+          // タイマを含めて全ての状態が繰り返している
+          if (maxStates == UINT64_MAX) {
+            m_ctrl.loopPeriod = period;
+            break;
+          }
+          states += fastForward(period, maxStates - states, true);
+        } else if (m_ctrl.tmrCtrlWrites == savedTmrCtrlWrites &&
+                   period < TmrClk &&
+                   static_cast<uint16_t>(m_state.tmrClkCnt - savedTmrClkCnt) ==
+                       period) {
+          // 周期の途中でタイマが進んでいない（周期がタイマの1周期より短いので、
+          // カウンタの差で判定できる）
+          states += fastForward(period, maxStates - states, false);
+          ++landmarkLambda;
+          if (m_state.tmrClkCnt == landmarkTmrClkCnt && state() == landmark) {
+            const uint64_t landmarkPeriod = states - landmarkStates;
+            if (maxStates == UINT64_MAX) {
+              m_ctrl.loopPeriod = landmarkPeriod;
+              break;
+            }
+            states += fastForward(landmarkPeriod, maxStates - states, true);
+            landmarkPower = 0;
+            landmarkLambda = 0;
+          }
+          if (landmarkLambda == landmarkPower) {
+            landmark = state();
+            landmarkStates = states;
+            landmarkTmrClkCnt = m_state.tmrClkCnt;
+            landmarkPower = std::max<size_t>(landmarkPower * 2, 1);
+            landmarkLambda = 0;
+          }
+        }
+        power = 0;
+        lambda = 0;
+      }
+      if (lambda == power) {
+        saved = state();
+        savedStates = states;
+        savedTmrClkCnt = m_state.tmrClkCnt;
+        savedTmrCtrlWrites = m_ctrl.tmrCtrlWrites;
+        power = std::clamp<size_t>(power * 2, 1, MaxCycleUnits);
+        lambda = 0;
+      }
+    } while (true);
+    return states;
+  }
+
+  /// @brief 入出力なしに永久に繰り返すループを検出したか
+  /// @return 直前の clockUntilIO() でループを検出したか
+  bool isLooping() const noexcept { return m_ctrl.loopPeriod != 0; }
+
+  /// @brief 検出したループを1周期分実行し、実行した命令の番地の範囲を求める。
+  /// @return 連続して並んだ命令の範囲ごとの、最初と最後の命令の番地（番地順）
+  /// @note
+  /// 割り込み処理や ROM のルーチンを呼び出すループは、離れた範囲に分かれる。
+  std::vector<std::pair<uint8_t, uint8_t>> traceLoop() {
+    std::array<bool, 256> executed{};
+    for (uint64_t states = 0; states < m_ctrl.loopPeriod;) {
+      beginHorizon(0, 1);
+      executed[m_state.pc] = true;
+      if (const uint8_t s = stepDecoded(); s != 0) {
+        states += s;
+      } else {
+        break;
+      }
+    }
+    std::vector<std::pair<uint8_t, uint8_t>> ranges;
+    // 直前の命令の次の番地（この番地の命令なら同じ範囲に含める）
+    size_t next = 0;
+    for (size_t addr = 0; addr < executed.size(); ++addr) {
+      if (not executed[addr]) {
+        continue;
+      }
+      const uint8_t pc = static_cast<uint8_t>(addr);
+      if (ranges.empty() || next < addr) {
+        ranges.emplace_back(pc, pc);
+      } else {
+        ranges.back().second = pc;
+      }
+      next = std::max(next, addr + FormatOf(m_state.mm[addr]).size);
+    }
+    return ranges;
+  }
+
+  /// @brief 命令の実行方式を設定する。
+  /// @param engine 実行方式
+  void setEngine(const Engine engine) noexcept { m_ctrl.engine = engine; }
+
+  /// @brief tec2c で C++ に変換したプログラムを設定する（Engine::Aot で実行する）。
+  /// @param aot 変換したプログラムの情報
+  /// @note 変換した命令を書き換えると、以降はインタプリタで実行する。
+  void setAot(const AotInfo &aot) noexcept {
+    m_ctrl.aotClock = aot.clock;
+    m_ctrl.aotCover = aot.cover;
+    m_ctrl.aotModified = false;
+  }
+
+  /// @brief 命令長を求める（tec2c 用）。
+  /// @param inst 命令の第1バイト
+  /// @return 命令長（フェッチするバイト数）
+  static constexpr uint8_t InstSize(const uint8_t inst) noexcept {
+    return FormatOf(inst).size;
+  }
+
+  /// @brief 命令の実行に要するステート数を求める（tec2c 用）。
+  /// @param inst 命令の第1バイト
+  /// @param operand 命令の第2バイト
+  /// @return ステート数（停止する命令や不正な命令の場合は0）
+  static constexpr uint8_t InstStates(const uint8_t inst,
+                                      const uint8_t operand) noexcept {
+    return StatesOf(inst, operand);
+  }
+
+  /// @brief 実行方式の段階ごとの統計を取得する。
+  /// @return 統計
+  const TierStats &getStats() const noexcept { return m_ctrl.stats; }
+
+  /// @brief シリアル入出力の FIFO の容量
+  static constexpr size_t SerialFifoSize = 4096;
+
+  /// @brief まだプログラムが受け取っていないシリアル入力があるか
+  /// @return 受信バッファが満杯か、入力 FIFO が空でなければ true
+  bool hasSerialIn() const noexcept {
+    return (m_state.intReq & Int1Bit) != 0 || not m_serialIn.empty();
+  }
+
+  /// @brief シリアル入力 FIFO に入るだけ書き込む。
+  /// @param data バイト列
+  /// @param size バイト数
+  /// @return 書き込んだバイト数
+  /// @note FIFO の先頭は、シリアル入出力の1バイト分の区切りで受信バッファが
+  /// 空であれば受信バッファへ移る。
+  size_t writeSerialIn(const uint8_t *data, const size_t size) noexcept {
+    return m_serialIn.push(data, size);
+  }
+
+  /// @brief シリアル出力 FIFO から取り出せるだけ読み取る。
+  /// @param data 読み取ったバイト列の格納先
+  /// @param size 格納先のバイト数
+  /// @return 読み取ったバイト数
+  /// @note 送信バッファは、シリアル入出力の1バイト分の区切りで FIFO へ移る。
+  size_t readSerialOut(uint8_t *data, const size_t size) noexcept {
+    return m_serialOut.pop(data, size);
+  }
+
+  /// @brief FIFO が満杯または空で止まっていたシリアル入出力の受け渡しを続ける。
+  /// @note clockUntilIO() から戻った後、FIFO を読み書きしてから呼び出す。
+  /// 止まった時点で受け渡したのと同じ結果になる。
+  void resumeSerial() noexcept {
+    if (m_state.serialPending) {
+      pollSerial();
+    }
+  }
+
+  /// @brief プログラムを主記憶に書き込む。
+  /// @param start 開始アドレス
+  /// @param size サイズ
+  /// @param values 値
+  void writeProg(const uint8_t start, const uint8_t size,
+                 const std::array<uint8_t, 256> &values) noexcept {
+    for (uint16_t i = 0; i < static_cast<uint16_t>(size); ++i) {
+      writeMem(static_cast<uint8_t>(start + i), values[i]);
+    }
+  }
+
+  /// @brief ゴールデンイメージ（プログラムを書き込んだ直後の TeC）と同じ状態に戻す。
+  /// @param image ゴールデンイメージ
+  /// @note
+  /// 主記憶は異なる番地だけを書き戻すので、書き換えられていない番地の
+  /// 解読済み命令、基本ブロック、機械語はそのまま次のケースで使える。
+  /// 統計はイメージの値（通常は0）に戻す。
+  void loadImage(const TeC &image) noexcept {
+    for (size_t addr = 0; addr < RomStartAddr; ++addr) {
+      if (m_state.mm[addr] != image.m_state.mm[addr]) {
+        writeMem(static_cast<uint8_t>(addr), image.m_state.mm[addr]);
+      }
+    }
+    // ROM 領域は書き換えられないので、主記憶はイメージと同じになっている
+    m_state = image.m_state;
+    m_ctrl = image.m_ctrl;
+    // イメージの FIFO は空（ケースの実行前に作る）
+    assert(image.m_serialIn.empty() && image.m_serialOut.empty());
+    m_serialIn.clear();
+    m_serialOut.clear();
+  }
+
+  /// @brief 状態のスナップショットを取る。
+  /// @return 主記憶、レジスタ、入出力（タイマ、割り込み、シリアル入出力の
+  /// FIFO を含む）の状態
+  /// @note
+  /// 解読済みの命令や実行の制限、周期の検出用の状態は含まない。
+  TeCSnapshot snapshot() const {
+    TeCSnapshot snap{.state = m_state,
+                     .serialIn = std::vector<uint8_t>(m_serialIn.size()),
+                     .serialOut = std::vector<uint8_t>(m_serialOut.size())};
+    m_serialIn.peek(snap.serialIn.data(), snap.serialIn.size());
+    m_serialOut.peek(snap.serialOut.data(), snap.serialOut.size());
+    return snap;
+  }
+
+  /// @brief スナップショットを取ったときの状態に戻す。
+  /// @param snap スナップショット（FIFO の内容は SerialFifoSize 以下）
+  /// @note
+  /// 主記憶は異なる番地だけを書き戻すので、変わっていない番地の解読済み命令や
+  /// 機械語はそのまま使える。ROM 領域と実行の制限は変えない。
+  void restore(const TeCSnapshot &snap) noexcept {
+    assert(snap.serialIn.size() <= SerialFifoSize &&
+           snap.serialOut.size() <= SerialFifoSize);
+    for (size_t addr = 0; addr < RomStartAddr; ++addr) {
+      if (m_state.mm[addr] != snap.state.mm[addr]) {
+        writeMem(static_cast<uint8_t>(addr), snap.state.mm[addr]);
+      }
+    }
+    const std::array<uint8_t, 256> mm = m_state.mm;
+    m_state = snap.state;
+    m_state.mm = mm;
+    m_state.intReq &= Int0Bit | Int1Bit | Int2Bit | Int3Bit;
+    m_state.intMask &= Int0Bit | Int1Bit | Int2Bit | Int3Bit;
+    m_serialIn.clear();
+    m_serialIn.push(snap.serialIn.data(), snap.serialIn.size());
+    m_serialOut.clear();
+    m_serialOut.push(snap.serialOut.data(), snap.serialOut.size());
+    // 戻した状態から周期を検出し直す
+    m_ctrl.loopPeriod = 0;
+  }
+
+  /// @brief コンソール割り込みを発生させる。
+  void write() noexcept { m_state.intReq |= Int3Bit; }
+
+  /// @brief パラレル出力の値を取得する。
+  /// @return パラレル出力の値
+  uint8_t readParallel() const noexcept { return m_state.parallelOut; }
+
+  /// @brief 拡張パラレル出力の値を取得する。
+  /// @return 拡張パラレル出力の値
+  uint8_t readExtParallel() const noexcept { return m_state.extParallelOut; }
+
+  /// @brief パラレル入力の値を設定する。
+  /// @param val パラレル入力の値
+  void writeParallel(const uint8_t val) noexcept {
+    m_state.parallelIn = val;
+    // HIGH: 3[V], LOW: 0[V] としたときの対応するアナログ値
+    static constexpr uint8_t HighVal = static_cast<uint8_t>(255 * 3.0F / 3.3F);
+    static constexpr uint8_t LowVal = 0;
+    m_state.adcChs[0] = (val & 0x01) != 0 ? HighVal : LowVal;
+    m_state.adcChs[1] = (val & 0x02) != 0 ? HighVal : LowVal;
+    m_state.adcChs[2] = (val & 0x04) != 0 ? HighVal : LowVal;
+    m_state.adcChs[3] = (val & 0x08) != 0 ? HighVal : LowVal;
+  }
+
+  /// @brief アナログ入力の値を設定する。
+  /// @param pin ピン番号 (0 ~ 3)
+  /// @param val アナログ入力の値
+  void writeAnalog(const uint8_t pin, const uint8_t val) noexcept {
+    assert(pin < m_state.adcChs.size());
+    m_state.adcChs[pin] = val;
+    // 1.6[V] を超えると 1 とする
+    static constexpr uint8_t Threshold =
+        static_cast<uint8_t>(255 * 1.6F / 3.3F);
+    m_state.parallelIn =
+        (m_state.parallelIn & ~(1 << pin)) | ((Threshold < val ? 1 : 0) << pin);
+  }
+
+private:
+  /// @brief レジスタ、主記憶、入出力の状態
+  TeCState m_state;
+
+  /// @brief 実行の制御と統計（ゴールデンイメージから丸ごと復元する）
+  struct Control {
+    /// @brief TMR-CTRL への書き込み回数（周期の検出用）
+    uint32_t tmrCtrlWrites;
+    /// @brief 入出力なしに永久に繰り返すループの周期（ステート数、なければ0）
+    uint64_t loopPeriod;
+    /// @brief 実行できるステート数の合計の上限
+    uint64_t stateLimit;
+    /// @brief 実行を打ち切る時刻
+    std::chrono::steady_clock::time_point deadline;
+    /// @brief 次に実時間を確かめるまでの clock() の呼び出し回数
+    uint32_t deadlineCountdown;
+    /// @brief 達した実行の制限
+    Limit limit;
+    /// @brief 命令の実行方式
+    Engine engine;
+    /// @brief タイマと割り込みを処理せずに命令を実行できる区間の終わり
+    /// （clock() を呼び出してからのステート数）
+    uint64_t horizon;
+    /// @brief 次のシリアル入出力の1バイト分の区切り
+    /// （clock() を呼び出してからのステート数）
+    uint64_t sliceEnd;
+    /// @brief clock() を呼び出してから通過した区切りの数
+    uint32_t slices;
+    /// @brief clock() から戻る区切りの間隔（周期の検出用）
+    uint32_t sampleSlices;
+    /// @brief シリアル入力 FIFO と受信バッファが空になったら clock() から戻るか
+    bool waitRxEmpty;
+    /// @brief シリアル入出力で受け渡したバイト数（周期の検出用）
+    uint32_t serialTransfers;
+    /// @brief 実行方式の段階ごとの統計
+    TierStats stats;
+    /// @brief tec2c で C++ に変換したプログラムの実行関数
+    uint64_t (*aotClock)(TeC &, uint64_t);
+    /// @brief 番地ごとの、tec2c で命令として変換したか
+    std::array<bool, 256> aotCover;
+    /// @brief tec2c で変換した命令が書き換えられたか
+    bool aotModified;
+  };
+  static_assert(std::is_trivially_copyable_v<Control>);
+  /// @brief 実行の制御と統計
+  Control m_ctrl;
+  /// @brief 実時間を確かめる間隔（clock() の呼び出し回数）
+  static constexpr uint32_t DeadlineCheckUnits = 1024;
+
+  /// @brief 命令の実行関数
+  using Exec = void (*)(TeC &, uint8_t) noexcept;
+  struct DecodedInst;
+  /// @brief 融合命令の実行関数
+  using FusedExec = void (*)(TeC &, const DecodedInst &) noexcept;
+  /// @brief 解読済み命令
+  struct DecodedInst {
+    /// @brief 実行関数（第1バイトごとに特殊化されたもの）
+    Exec exec;
+    /// @brief この番地から始まる3命令を融合した実行関数（なければ nullptr）
+    FusedExec fused;
+    /// @brief 第2バイト（オペランド）
+    uint8_t operand;
+    /// @brief 命令長（フェッチするバイト数）
+    uint8_t size;
+    /// @brief 実行に要するステート数（エラーの場合は0）
+    uint8_t states;
+    /// @brief 解読済みか
+    bool valid;
+    /// @brief 解読に使ったバイト数（融合命令を含む）
+    uint8_t span;
+    /// @brief 融合命令の2命令目のオペランド（即値）
+    uint8_t fusedImm;
+    /// @brief 融合命令の3命令目のオペランド（分岐先）
+    uint8_t fusedTarget;
+    /// @brief 融合命令の実行に要するステート数
+    uint8_t fusedStates;
+    /// @brief 融合命令の最後の命令を除いたステート数
+    uint8_t fusedHeadStates;
+  };
+  /// @brief 主記憶の番地ごとの解読済み命令
+  std::array<DecodedInst, 256> m_decoded;
+  /// @brief 番地ごとの、その番地を含む融合命令を解読したことがあるか
+  std::array<bool, 256> m_fusedCover;
+  struct JitContext;
+  /// @brief 機械語に変換した命令列（実行したステート数を返す）
+  using Native = uint16_t (*)(JitContext *) noexcept;
+  /// @brief 基本ブロック
+  /// （ジャンプ命令や割り込み状態を変える命令で終わる直線的な命令列）
+  struct Block {
+    /// @brief 命令列
+    std::vector<DecodedInst> insts;
+    /// @brief 命令列全体のステート数
+    uint16_t states;
+    /// @brief 最後の命令を除いたステート数
+    uint16_t headStates;
+    /// @brief 命令列が占めるバイト数
+    uint8_t size;
+    /// @brief 変換済みか
+    bool valid;
+    /// @brief 先頭から nativeInsts 個の命令を変換した機械語（なければ nullptr）
+    Native native;
+    /// @brief 機械語に変換した命令数
+    uint8_t nativeInsts;
+    /// @brief 実行回数（機械語に変換するまで数える）
+    uint8_t hotness;
+  };
+  /// @brief 先頭番地ごとの基本ブロック
+  std::array<Block, 256> m_blocks;
+  /// @brief 番地ごとの、その番地を含む変換済みの基本ブロックの数
+  std::array<uint8_t, 256> m_blockCover;
+  /// @brief シリアル入力 FIFO
+  RingBuffer<SerialFifoSize> m_serialIn;
+  /// @brief シリアル出力 FIFO
+  RingBuffer<SerialFifoSize> m_serialOut;
+  /// @brief 機械語と TeC の間で受け渡す状態
+  struct JitContext {
+    /// @brief 主記憶の先頭アドレス
+    uint8_t *mm;
+    /// @brief 実行中の TeC
+    TeC *tec;
+    /// @brief 実行中の基本ブロック
+    const Block *block;
+    // レジスタ
+    uint8_t g0;
+    uint8_t g1;
+    uint8_t g2;
+    uint8_t sp;
+    uint8_t pc;
+    // フラグ (0 または 1)
+    uint8_t c;
+    uint8_t s;
+    uint8_t z;
+  };
+#if TEC_JIT
+  /// @brief 変換した機械語を置く領域（最初に変換するときに確保する）
+  std::unique_ptr<CodeBuffer> m_code;
+#endif
+
+  /// @brief タイマカウンタの増加させるステート数
+  static constexpr uint16_t TmrClk = static_cast<uint16_t>(StatesPerSec / 75);
+  /// @brief INT0（タイマ）割り込みベクタ
+  static constexpr uint8_t Int0Vec = 0xDC;
+  /// @brief INT1（SIO受信）割り込みベクタ
+  static constexpr uint8_t Int1Vec = 0xDD;
+  /// @brief INT2（SIO送信）割り込みベクタ
+  static constexpr uint8_t Int2Vec = 0xDE;
+  /// @brief INT3 (コンソール) 割り込みベクタ
+  static constexpr uint8_t Int3Vec = 0xDF;
+  /// @brief INT0（タイマ）割り込みのビット
+  static constexpr uint8_t Int0Bit = 0x01;
+  /// @brief INT1（SIO受信）割り込みのビット
+  static constexpr uint8_t Int1Bit = 0x02;
+  /// @brief INT2（SIO送信）割り込みのビット
+  static constexpr uint8_t Int2Bit = 0x04;
+  /// @brief INT3（コンソール）割り込みのビット
+  static constexpr uint8_t Int3Bit = 0x08;
+
+  /// @brief 命令の実行結果に影響する状態
+  /// （タイマを動作させるためのカウンタと、実行方式ごとの作業用の情報を除く）
+  struct State {
+    /// @brief レジスタ、主記憶、入出力の状態
+    /// （タイマを動作させるためのカウンタと、実行したステート数は0にする）
+    TeCState tec;
+    // シリアル入出力の受け渡しがあれば、同じ状態とはみなさない
+    uint32_t serialTransfers;
+
+    bool operator==(const State &) const = default;
+  };
+
+  /// @brief 現在の状態を求める。
+  State state() const noexcept {
+    State state{.tec = m_state, .serialTransfers = m_ctrl.serialTransfers};
+    state.tec.tmrClkCnt = 0;
+    state.tec.totalStates = 0;
+    return state;
+  }
+
+  /// @brief 周期を検出する clock() の呼び出しの最大数
+  static constexpr size_t MaxCycleUnits = 512;
+  /// @brief 周期を検出するために clock() から戻る区切りの最大の間隔
+  static constexpr uint32_t MaxSampleSlices = 64;
+
+  /// @brief 繰り返している周期の分だけ時間を進める。
+  /// @param period 周期（ステート数）
+  /// @param remaining 残りのステート数
+  /// @param exact タイマを動作させるためのカウンタを含めて繰り返しているか
+  /// @return 進めたステート数
+  /// @note
+  /// 最後のシリアル入出力の1バイト分を通常どおり実行できる範囲で、
+  /// 周期の整数倍だけ進める。exact でなければ、周期の途中でタイマが進まない
+  /// 範囲に限る。
+  uint64_t fastForward(const uint64_t period, uint64_t remaining,
+                       const bool exact) noexcept {
+    remaining = std::min(remaining, remainingStates());
+    uint64_t count = remaining < SerialUnitStates
+                         ? 0
+                         : (remaining - SerialUnitStates) / period;
+    if (m_state.tmrEna && not exact) {
+      count = m_state.tmrClkCnt < TmrClk
+                  ? std::min<uint64_t>(count,
+                                       (TmrClk - m_state.tmrClkCnt) / period)
+                  : 0;
+    }
+    const uint64_t states = count * period;
+    if (not (m_state.tmrEna && exact)) {
+      // タイマが無効な間もカウンタは進む（16ビットで循環する）
+      m_state.tmrClkCnt = static_cast<uint16_t>(m_state.tmrClkCnt + states);
+    }
+    m_state.totalStates += states;
+    return states;
+  }
+
+  /// @brief 実行できるステート数の合計の上限までの残りを求める。
+  /// @return ステート数
+  uint64_t remainingStates() const noexcept {
+    return m_state.totalStates < m_ctrl.stateLimit
+               ? m_ctrl.stateLimit - m_state.totalStates
+               : 0;
+  }
+
+  /// @brief 主記憶へ値を書き込む。ただし、ROM領域には書き込まない。
+  /// @param addr アドレス
+  /// @param val 値
+  void writeMem(const uint8_t addr, const uint8_t val) noexcept {
+    if (addr < RomStartAddr) {
+      m_state.mm[addr] = val;
+      // 書き換えた番地を命令またはオペランドとして含む解読済み命令を無効化
+      m_decoded[addr].valid = false;
+      if (DecodedInst &prev = m_decoded[static_cast<uint8_t>(addr - 1)];
+          1 < prev.span) {
+        prev.valid = false;
+      }
+      if (m_fusedCover[addr]) {
+        invalidateFused(addr);
+      }
+      if (m_ctrl.aotCover[addr]) {
+        m_ctrl.aotModified = true;
+      }
+      if (m_blockCover[addr] != 0) {
+        invalidateBlocks(addr);
+      }
+    }
+  }
+
+  /// @brief addr 番地を3命令目までに含む融合命令を無効化する。
+  /// @param addr 書き換えた番地
+  void invalidateFused(const uint8_t addr) noexcept {
+    for (uint8_t i = 2; i < FusedSize; ++i) {
+      if (DecodedInst &inst = m_decoded[static_cast<uint8_t>(addr - i)];
+          i < inst.span) {
+        inst.valid = false;
+      }
+    }
+    m_fusedCover[addr] = false;
+  }
+
+  /// @brief 主記憶の値を読む。
+  /// @param addr アドレス
+  /// @return 値
+  uint8_t readMem(const uint8_t addr) const noexcept {
+    return m_state.mm[addr];
+  }
+
+  /// @brief C フラグの値を求める。
+  bool flgC() const noexcept { return m_state.flgC(); }
+
+  /// @brief S フラグの値を求める。
+  bool flgS() const noexcept { return m_state.flgS(); }
+
+  /// @brief Z フラグの値を求める。
+  bool flgZ() const noexcept { return m_state.flgZ(); }
+
+  /// @brief フラグの値を設定する。
+  void setFlgs(const bool c, const bool s, const bool z) noexcept {
+    m_state.setFlgs(c, s, z);
+  }
+
+  /// @brief エラーフラグを1に、実行フラグを0にする。
+  void error() noexcept {
+    m_state.err = true;
+    m_state.run = false;
+    endHorizon();
+  }
+
+  /// @brief 指定した割り込みベクタで割り込みを発生させる。
+  /// @param vec 割り込みベクタ
+  void interrupt(const uint8_t vec) noexcept {
+    // PCをスタックに退避
+    writeMem(--m_state.sp, m_state.pc);
+    // フラグをスタックに退避
+    writeMem(--m_state.sp,
+             static_cast<uint8_t>(
+                 (m_state.intEna ? 0x80 : 0x00) | (flgC() ? 0x04 : 0x00) |
+                 (flgS() ? 0x02 : 0x00) | (flgZ() ? 0x01 : 0x00)));
+    // プログラムカウンタの値を割り込みベクタに設定
+    m_state.pc = readMem(vec);
+    // 割り込みを無効化
+    m_state.intEna = false;
+  }
+
+  /// @brief タイマを進め、保留中の割り込みを受け付ける。
+  /// @note 区間の始めに呼び出す（beginHorizon() を参照）。
+  void serviceDevices() noexcept {
+    // タイマ
+    if (m_state.tmrEna) {
+      if (TmrClk <= m_state.tmrClkCnt) {
+        m_state.tmrClkCnt = 0;
+        if (m_state.tmrCnt == m_state.tmrPeriod) {
+          m_state.tmrCnt = 0;
+          m_state.tmrElapsed = true;
+          m_state.intReq |= m_state.intMask & Int0Bit;
+        } else {
+          ++m_state.tmrCnt;
+        }
+      }
+    }
+    // 割り込み（番号の小さいものが優先）
+    if (const uint8_t req =
+            m_state.intEna ? m_state.intReq & m_state.intMask : 0;
+        req != 0) {
+      const uint8_t n = static_cast<uint8_t>(std::countr_zero(req));
+      // INT0, INT3 は受け付けたらリセット（INT1, INT2 はバッファの状態）
+      m_state.intReq &= static_cast<uint8_t>(~((1 << n) & (Int0Bit | Int3Bit)));
+      interrupt(static_cast<uint8_t>(Int0Vec + n));
+    }
+  }
+
+  /// @brief タイマと割り込みを処理し、次に処理が必要になるまでの区間を求める。
+  /// @param states clock() を呼び出してから実行したステート数
+  /// @param maxStates 実行する最大ステート数
+  /// @note
+  /// m_ctrl.horizon に達するまでは serviceDevices() が何もしないので、
+  /// それまでの命令はタイマと割り込みを処理せずに実行してよい。
+  void beginHorizon(const uint64_t states, const uint64_t maxStates) noexcept {
+    serviceDevices();
+    // 最大ステート数と、シリアル入出力の1バイト分の区切りのうち早い方
+    m_ctrl.horizon = std::min(maxStates, m_ctrl.sliceEnd);
+    if (m_state.tmrEna) {
+      // 次にタイマが進む命令の開始時
+      m_ctrl.horizon = std::min<uint64_t>(m_ctrl.horizon,
+                                          states + TmrClk - m_state.tmrClkCnt);
+    }
+  }
+
+  /// @brief 区間の終わりに、clock() から戻るかを判定する。
+  /// @param states clock() を呼び出してから実行したステート数
+  /// @param maxStates 実行する最大ステート数
+  /// @return 戻るなら true
+  /// @note
+  /// シリアル入出力の1バイト分の区切りに達していれば次の区切りを求め、
+  /// シリアル入出力の受け渡しが必要なとき（main() が区切りごとに確認する
+  /// 条件）か、m_ctrl.sampleSlices 個目の区切りのときに戻る。
+  /// 区切りは命令の途中に来ないため、受け渡しの時刻を決めるには
+  /// 受け渡しがない間も区切りを追跡する必要がある。
+  bool isClockDone(const uint64_t states, const uint64_t maxStates) noexcept {
+    if (maxStates <= states || not m_state.run) {
+      return true;
+    }
+    if (states < m_ctrl.sliceEnd) {
+      return false;
+    }
+    m_ctrl.sliceEnd = states + SerialUnitStates;
+    pollSerial();
+    return ++m_ctrl.slices == m_ctrl.sampleSlices || m_state.serialPending;
+  }
+
+  /// @brief シリアル入出力の受け渡しを行う。
+  /// @note
+  /// シリアル入出力の1バイト分の区切りと clock() の終わりに呼び出す。
+  /// 送信バッファが満杯なら出力 FIFO へ移し、受信バッファが空なら
+  /// 入力 FIFO の先頭を移す。FIFO が満杯または空で受け渡せなかった場合は
+  /// m_state.serialPending を設定する（main() が FIFO を読み書きするまで止まる）。
+  void pollSerial() noexcept {
+    if ((m_state.intReq & Int2Bit) == 0 && not m_serialOut.full()) {
+      m_serialOut.push(m_state.txReg);
+      m_state.intReq |= Int2Bit;
+      ++m_ctrl.serialTransfers;
+    }
+    if ((m_state.intReq & Int1Bit) == 0 && not m_serialIn.empty()) {
+      m_state.rxReg = m_serialIn.pop();
+      m_state.intReq |= Int1Bit;
+      ++m_ctrl.serialTransfers;
+    }
+    m_state.serialPending =
+        (m_state.intReq & Int2Bit) == 0 ||
+        (m_ctrl.waitRxEmpty && (m_state.intReq & Int1Bit) == 0 &&
+         m_serialIn.empty());
+  }
+
+  /// @brief 現在の区間を打ち切る（次の命令の前にタイマと割り込みを処理する）。
+  /// @note 入出力装置や割り込みの状態を変える命令、停止する命令で呼び出す。
+  void endHorizon() noexcept { m_ctrl.horizon = 0; }
+
+  /// @brief 区間の途中から、解読済みの命令を1命令ずつ実行する。
+  /// @param states clock() を呼び出してから実行したステート数
+  /// @param maxStates 実行する最大ステート数
+  /// @return 実行したステート数
+  /// @note
+  /// beginHorizon() の後か、区間内で命令を実行した後に呼び出す
+  /// （少なくとも1命令は実行する）。
+  uint64_t resumeInterp(uint64_t states, const uint64_t maxStates) noexcept {
+    do {
+      do {
+        states += stepInterp(states);
+      } while (states < m_ctrl.horizon);
+      if (isClockDone(states, maxStates)) {
+        return states;
+      }
+      beginHorizon(states, maxStates);
+    } while (true);
+  }
+
+  /// @brief インタプリタで1命令（融合命令や ROM のルーチンはまとめて）実行する。
+  /// @param states clock() を呼び出してから実行したステート数
+  /// @return 実行に要したステート数（エラーの場合は0）
+  uint16_t stepInterp(const uint64_t states) noexcept {
+    return m_state.pc == RomReadAddr ? runRomRead(states) : stepFused(states);
+  }
+
+  /// @brief タイマと割り込みを処理せずに、解読済みの命令を1命令実行する。
+  /// @return 実行に要したステート数（エラーの場合は0）
+  uint8_t stepDecoded() noexcept { return execDecoded(decoded(m_state.pc)); }
+
+  /// @brief stepDecoded() と同様に実行する。ただし、融合命令があり、
+  /// その最後の命令が区間内に始まる場合は、融合した3命令をまとめて実行する。
+  /// @param states clock() を呼び出してから実行したステート数
+  /// @return 実行に要したステート数（エラーの場合は0）
+  uint8_t stepFused(const uint64_t states) noexcept {
+    const DecodedInst &inst = decoded(m_state.pc);
+    if (inst.fused != nullptr &&
+        states + inst.fusedHeadStates < m_ctrl.horizon) {
+      inst.fused(*this, inst);
+      m_state.tmrClkCnt += inst.fusedStates;
+      return inst.fusedStates;
+    }
+    return execDecoded(inst);
+  }
+
+  /// @brief addr 番地の解読済み命令を求める（解読済みでなければ解読する）。
+  /// @param addr 命令のアドレス
+  /// @return 解読済み命令
+  const DecodedInst &decoded(const uint8_t addr) noexcept {
+    DecodedInst &inst = m_decoded[addr];
+    if (not inst.valid) {
+      inst = decode(addr);
+      if (inst.fused != nullptr) {
+        for (uint8_t i = 0; i < FusedSize; ++i) {
+          m_fusedCover[static_cast<uint8_t>(addr + i)] = true;
+        }
+      }
+    }
+    return inst;
+  }
+
+  /// @brief 解読済みの命令を1命令実行する。
+  /// @param inst 現在の PC の解読済み命令
+  /// @return 実行に要したステート数（エラーの場合は0）
+  uint8_t execDecoded(const DecodedInst &inst) noexcept {
+    m_state.pc = static_cast<uint8_t>(m_state.pc + inst.size);
+    inst.exec(*this, inst.operand);
+    // 実行したステート数（= クロック数）をカウント
+    m_state.tmrClkCnt += inst.states;
+    return inst.states;
+  }
+
+  /// @brief 基本ブロックの最大命令数
+  static constexpr size_t MaxBlockInsts = 32;
+
+  /// @brief 基本ブロック単位で指定したステート数の命令を実行する。
+  /// @param maxStates 実行する最大ステート数
+  /// @return 実行したステート数
+  /// @note
+  /// ブロックの最後の命令が区間内に始まる場合だけブロックをまとめて実行する。
+  /// そうでなければ1命令ずつ実行して、インタプリタと同じ結果にする。
+  uint64_t clockBlock(const uint64_t maxStates) noexcept {
+    uint64_t states = 0;
+    do {
+      beginHorizon(states, maxStates);
+      do {
+        if (m_state.pc == RomReadAddr) {
+          states += runRomRead(states);
+          continue;
+        }
+        Block &block = m_blocks[m_state.pc];
+        if (not block.valid) {
+          translate(m_state.pc);
+        }
+        if (states + block.headStates < m_ctrl.horizon) {
+          states += runBlock(block);
+        } else {
+          states += stepDecoded();
+        }
+      } while (states < m_ctrl.horizon);
+    } while (not isClockDone(states, maxStates));
+    return states;
+  }
+
+  /// @brief 基本ブロックを実行する。
+  /// @param block 基本ブロック
+  /// @return 実行に要したステート数
+  uint16_t runBlock(const Block &block) noexcept {
+    uint16_t states = 0;
+    for (const DecodedInst &inst : block.insts) {
+      m_state.pc = static_cast<uint8_t>(m_state.pc + inst.size);
+      inst.exec(*this, inst.operand);
+      states += inst.states;
+      // 自分自身を書き換えた場合は、残りの命令を実行しない
+      if (not block.valid) {
+        break;
+      }
+    }
+    // 実行したステート数（= クロック数）をまとめてカウント
+    m_state.tmrClkCnt += states;
+    return states;
+  }
+
+  /// @brief 基本ブロックを終える命令か判定する。
+  /// @param inst 命令の第1バイト
+  /// @param operand 命令の第2バイト
+  /// @return 分岐・停止・エラーの可能性があるか、タイマか割り込みの状態を
+  /// 変える場合は true
+  static constexpr bool EndsBlock(const uint8_t inst,
+                                  const uint8_t operand) noexcept {
+    const uint8_t op = static_cast<uint8_t>((inst >> 4) & 0x0F);
+    const uint8_t xr = static_cast<uint8_t>(inst & 0x03);
+    return StatesOf(inst, operand) == 0 ||     // HALT, 不正な命令
+           op == 0xA || op == 0xB ||           // Jump, CALL
+           inst == 0xEC || inst == 0xEF ||     // RET, RETI
+           inst == 0xE0 ||                     // EI
+           (op == 0xC && xr == 0b11 &&
+            OutEndsHorizon(operand));          // OUT（タイマ・割り込み）
+  }
+
+  /// @brief start 番地から始まる基本ブロックを変換する。
+  /// @param start 先頭番地
+  void translate(const uint8_t start) {
+    const auto begin = std::chrono::steady_clock::now();
+    Block &block = m_blocks[start];
+    block.insts.clear();
+    block.states = 0;
+    uint8_t pc = start;
+    uint8_t size = 0;
+    for (size_t i = 0; i < MaxBlockInsts; ++i) {
+      const DecodedInst &inst = block.insts.emplace_back(decode(pc));
+      block.states = static_cast<uint16_t>(block.states + inst.states);
+      size = static_cast<uint8_t>(size + inst.size);
+      if (EndsBlock(readMem(pc), inst.operand)) {
+        break;
+      }
+      pc = static_cast<uint8_t>(pc + inst.size);
+    }
+    block.headStates =
+        static_cast<uint16_t>(block.states - block.insts.back().states);
+    block.size = size;
+    block.valid = true;
+    block.native = nullptr;
+    block.nativeInsts = 0;
+    block.hotness = 0;
+    for (uint8_t i = 0; i < size; ++i) {
+      ++m_blockCover[static_cast<uint8_t>(start + i)];
+    }
+    ++m_ctrl.stats.translations;
+    m_ctrl.stats.translatedInsts += block.insts.size();
+    m_ctrl.stats.translateTime += std::chrono::steady_clock::now() - begin;
+  }
+
+  /// @brief addr 番地を含む基本ブロックを無効化する。
+  /// @param addr 書き換えた番地
+  void invalidateBlocks(const uint8_t addr) noexcept {
+    for (size_t start = 0; start < m_blocks.size(); ++start) {
+      Block &block = m_blocks[start];
+      if (block.valid &&
+          static_cast<uint8_t>(addr - start) < block.size) {
+        block.valid = false;
+        // Engine::Tiered では、再び1命令ずつの実行から数え直す
+        block.hotness = 0;
+        for (uint8_t i = 0; i < block.size; ++i) {
+          --m_blockCover[static_cast<uint8_t>(start + i)];
+        }
+        ++m_ctrl.stats.invalidations;
+      }
+    }
+  }
+
+  /// @brief 機械語に変換するまでの基本ブロックの実行回数
+  static constexpr uint8_t JitThreshold = 16;
+  /// @brief 機械語を置く領域のバイト数
+  static constexpr size_t JitCodeCapacity = 1 << 20;
+
+  /// @brief 何度も実行される基本ブロックを機械語に変換して、
+  /// 指定したステート数の命令を実行する。
+  /// @param maxStates 実行する最大ステート数
+  /// @return 実行したステート数
+  /// @note
+  /// ブロックを実行する条件は clockBlock() と同じ。
+  /// 機械語に変換できない環境では clockBlock() と同じ動作をする。
+  uint64_t clockJit(const uint64_t maxStates) {
+#if TEC_JIT
+    uint64_t states = 0;
+    do {
+      beginHorizon(states, maxStates);
+      do {
+        if (m_state.pc == RomReadAddr) {
+          states += runRomRead(states);
+          continue;
+        }
+        Block &block = m_blocks[m_state.pc];
+        if (not block.valid) {
+          translate(m_state.pc);
+        }
+        if (states + block.headStates < m_ctrl.horizon) {
+          if (block.native == nullptr && block.hotness < JitThreshold &&
+              ++block.hotness == JitThreshold) {
+            compileBlock(m_state.pc);
+          }
+          states +=
+              block.native != nullptr ? runNative(block) : runBlock(block);
+        } else {
+          states += stepDecoded();
+        }
+      } while (states < m_ctrl.horizon);
+    } while (not isClockDone(states, maxStates));
+    return states;
+#else
+    return clockBlock(maxStates);
+#endif
+  }
+
+  /// @brief 基本ブロックに変換するまでの、その番地から1命令ずつ実行した回数
+  static constexpr uint8_t BlockThreshold = 4;
+
+  /// @brief 実行回数に応じて実行方式を切り替えながら、指定したステート数の
+  /// 命令を実行する。
+  /// @param maxStates 実行する最大ステート数
+  /// @return 実行したステート数
+  /// @note
+  /// はじめは解読も変換もせずに1命令ずつ実行し（step()）、BlockThreshold 回
+  /// 実行した番地から始まる命令列を基本ブロックに変換する。さらに JitThreshold
+  /// 回実行した基本ブロックは機械語に変換する（実行回数は Block::hotness で
+  /// 数える）。書き換えで無効化された基本ブロックは1命令ずつの実行に戻る。
+  /// 短いプログラムでは変換の負担がなく、長く実行されるループだけが変換される。
+  /// @note ブロックを実行する条件は clockBlock() と同じ。
+  uint64_t clockTiered(const uint64_t maxStates) {
+    uint64_t states = 0;
+    do {
+      beginHorizon(states, maxStates);
+      do {
+        if (m_state.pc == RomReadAddr) {
+          const uint16_t n = runRomRead(states);
+          m_ctrl.stats.romStates += n;
+          states += n;
+          continue;
+        }
+        Block &block = m_blocks[m_state.pc];
+        if (not block.valid && ++block.hotness == BlockThreshold) {
+          translate(m_state.pc);
+        }
+        if (block.valid && states + block.headStates < m_ctrl.horizon) {
+#if TEC_JIT
+          if (block.native == nullptr && block.hotness < JitThreshold &&
+              ++block.hotness == JitThreshold) {
+            compileBlock(m_state.pc);
+          }
+          if (block.native != nullptr) {
+            const uint16_t n = runNative(block);
+            m_ctrl.stats.nativeStates += n;
+            states += n;
+            continue;
+          }
+#endif
+          const uint16_t n = runBlock(block);
+          m_ctrl.stats.blockStates += n;
+          states += n;
+        } else {
+          const uint8_t n = step();
+          m_ctrl.stats.stepStates += n;
+          states += n;
+        }
+      } while (states < m_ctrl.horizon);
+    } while (not isClockDone(states, maxStates));
+    return states;
+  }
+
+  /// @brief 解読済みの命令を使わずに1命令実行する（タイマと割り込みは処理しない）。
+  /// @return 実行に要したステート数（エラーの場合は0）
+  uint8_t step() noexcept {
+    switch (readMem(m_state.pc)) {
+#define TEC_CASE(inst)                                                         \
+  case inst:                                                                   \
+    return stepThreaded<inst>();
+      TEC_FOR_EACH_INST(TEC_CASE)
+#undef TEC_CASE
+    }
+    return 0;
+  }
+
+#if TEC_JIT
+  /// @brief 機械語に変換した基本ブロックを実行する。
+  /// @param block 基本ブロック
+  /// @return 実行に要したステート数
+  /// @note 機械語に変換できなかった残りの命令は runBlock() と同様に実行する。
+  uint16_t runNative(const Block &block) noexcept {
+    JitContext ctx{.mm = m_state.mm.data(),
+                   .tec = this,
+                   .block = &block,
+                   .g0 = m_state.g0,
+                   .g1 = m_state.g1,
+                   .g2 = m_state.g2,
+                   .sp = m_state.sp,
+                   .pc = m_state.pc,
+                   .c = flgC(),
+                   .s = flgS(),
+                   .z = flgZ()};
+    uint16_t states = block.native(&ctx);
+    m_state.g0 = ctx.g0;
+    m_state.g1 = ctx.g1;
+    m_state.g2 = ctx.g2;
+    m_state.sp = ctx.sp;
+    m_state.pc = ctx.pc;
+    setFlgs(ctx.c != 0, ctx.s != 0, ctx.z != 0);
+    for (size_t i = block.nativeInsts; i < block.insts.size() && block.valid;
+         ++i) {
+      const DecodedInst &inst = block.insts[i];
+      m_state.pc = static_cast<uint8_t>(m_state.pc + inst.size);
+      inst.exec(*this, inst.operand);
+      states += inst.states;
+    }
+    // 実行したステート数（= クロック数）をまとめてカウント
+    m_state.tmrClkCnt += states;
+    return states;
+  }
+
+  /// @brief 機械語から主記憶へ値を書き込む。
+  /// @return 実行中の基本ブロックが書き換えられていなければ 1
+  static uint8_t JitWriteMem(JitContext *ctx, const uint32_t addr,
+                             const uint32_t val) noexcept {
+    ctx->tec->writeMem(static_cast<uint8_t>(addr), static_cast<uint8_t>(val));
+    return ctx->block->valid ? 1 : 0;
+  }
+
+  /// @brief 機械語から入出力装置の値を読む。
+  static uint8_t JitIn(JitContext *ctx, const uint32_t addr) noexcept {
+    return ctx->tec->in(static_cast<uint8_t>(addr));
+  }
+
+  /// @brief 機械語から入出力装置へ値を書き込む（区間を打ち切らないアドレスのみ）。
+  static void JitOut(JitContext *ctx, const uint32_t addr,
+                     const uint32_t val) noexcept {
+    ctx->tec->out(static_cast<uint8_t>(addr), static_cast<uint8_t>(val));
+  }
+
+  /// @brief 機械語で G0, G1, G2, SP を割り当てるレジスタ（呼び出し先保存）
+  static constexpr std::array<uint8_t, 4> JitRegs = {
+      X64Emitter::RBX, X64Emitter::R12, X64Emitter::R13, X64Emitter::R14};
+
+  /// @brief start 番地から始まる基本ブロックを機械語に変換する。
+  /// @param start 先頭番地
+  /// @note
+  /// 変換できない命令（タイマか割り込みの状態を変える OUT, EI, DI, RETI など）が
+  /// あれば、その直前までを変換する。
+  /// 機械語の中では rbp が JitContext を、r15 が主記憶を指す。
+  void compileBlock(const uint8_t start) {
+    using E = X64Emitter;
+    const auto begin = std::chrono::steady_clock::now();
+    Block &block = m_blocks[start];
+    E e;
+    e.push(E::RBP);
+    e.push(E::RBX);
+    e.push(E::R12);
+    e.push(E::R13);
+    e.push(E::R14);
+    e.push(E::R15);
+    e.subRI8x64(E::RSP, 8); // スタックを16バイト境界に揃える
+    e.movRR64(E::RBP, E::RDI);
+    e.loadRbp64(E::R15, offsetof(JitContext, mm));
+    e.loadRbp8(JitRegs[0], offsetof(JitContext, g0));
+    e.loadRbp8(JitRegs[1], offsetof(JitContext, g1));
+    e.loadRbp8(JitRegs[2], offsetof(JitContext, g2));
+    e.loadRbp8(JitRegs[3], offsetof(JitContext, sp));
+    uint8_t pc = start;
+    uint16_t states = 0;
+    size_t count = 0;
+    bool ended = false;
+    for (const DecodedInst &inst : block.insts) {
+      const uint8_t first = readMem(pc);
+      const uint8_t next = static_cast<uint8_t>(pc + inst.size);
+      const uint16_t total = static_cast<uint16_t>(states + inst.states);
+      if (not emitInst(e, first, inst.operand, next, total)) {
+        break;
+      }
+      pc = next;
+      states = total;
+      ++count;
+      if (EndsBlock(first, inst.operand)) {
+        ended = true; // 分岐命令は自分で機械語から戻る
+        break;
+      }
+    }
+    if (count == 0) {
+      return;
+    }
+    if (not ended) {
+      e.storeRbpI8(offsetof(JitContext, pc), pc);
+      emitReturn(e, states);
+    }
+    if (m_code == nullptr) {
+      m_code = std::make_unique<CodeBuffer>(JitCodeCapacity);
+    }
+    const void *code = m_code->add(e.code());
+    if (code == nullptr) {
+      // 領域が足りなければ、全ての機械語を破棄してやり直す
+      m_code->clear();
+      for (Block &b : m_blocks) {
+        b.native = nullptr;
+        b.hotness = 0;
+      }
+      code = m_code->add(e.code());
+    }
+    if (code != nullptr) {
+      block.native = reinterpret_cast<Native>(code);
+      block.nativeInsts = static_cast<uint8_t>(count);
+      ++m_ctrl.stats.compilations;
+      m_ctrl.stats.compiledInsts += count;
+    }
+    m_ctrl.stats.compileTime += std::chrono::steady_clock::now() - begin;
+  }
+
+  /// @brief 実効アドレスを eax に求める機械語を出力する。
+  /// @param e 出力先
+  /// @param xr XR（即値以外）
+  /// @param operand 命令の第2バイト
+  static void emitAddr(X64Emitter &e, const uint8_t xr, const uint8_t operand) {
+    if (xr == 0b00) {
+      e.movRI32(X64Emitter::RAX, operand);
+    } else {
+      e.movzxRR8(X64Emitter::RAX, JitRegs[xr]);
+      e.aluRI8(0, X64Emitter::RAX, operand); // add al, operand
+    }
+  }
+
+  /// @brief 演算結果のフラグを JitContext に保存する機械語を出力する。
+  static void emitFlags(X64Emitter &e) {
+    e.setccRbp(X64Emitter::B, offsetof(JitContext, c));
+    e.setccRbp(X64Emitter::S, offsetof(JitContext, s));
+    e.setccRbp(X64Emitter::E, offsetof(JitContext, z));
+  }
+
+  /// @brief レジスタを JitContext に保存して戻る機械語を出力する。
+  /// @param e 出力先
+  /// @param states 戻り値（実行したステート数）
+  static void emitReturn(X64Emitter &e, const uint16_t states) {
+    using E = X64Emitter;
+    e.storeRbp8(offsetof(JitContext, g0), JitRegs[0]);
+    e.storeRbp8(offsetof(JitContext, g1), JitRegs[1]);
+    e.storeRbp8(offsetof(JitContext, g2), JitRegs[2]);
+    e.storeRbp8(offsetof(JitContext, sp), JitRegs[3]);
+    e.movRI32(E::RAX, states);
+    e.addRI8x64(E::RSP, 8);
+    e.pop(E::R15);
+    e.pop(E::R14);
+    e.pop(E::R13);
+    e.pop(E::R12);
+    e.pop(E::RBX);
+    e.pop(E::RBP);
+    e.ret();
+  }
+
+  /// @brief 主記憶へ書き込む関数を呼び出す機械語を出力する。
+  /// @note 書き込む番地を esi に、値を edx に入れてから使う。
+  static void emitWriteMem(X64Emitter &e) {
+    e.movRR64(X64Emitter::RDI, X64Emitter::RBP);
+    e.movRI64(X64Emitter::RAX, reinterpret_cast<uint64_t>(&TeC::JitWriteMem));
+    e.callR(X64Emitter::RAX);
+  }
+
+  /// @brief 実行中の基本ブロックが書き換えられていれば戻る機械語を出力する。
+  /// @param e 出力先
+  /// @param next 次の命令の番地
+  /// @param states 書き込んだ命令までのステート数
+  static void emitReturnIfInvalidated(X64Emitter &e, const uint8_t next,
+                                      const uint16_t states) {
+    X64Emitter ret;
+    ret.storeRbpI8(offsetof(JitContext, pc), next);
+    emitReturn(ret, states);
+    e.testRR8(X64Emitter::RAX, X64Emitter::RAX);
+    e.jcc8(X64Emitter::NE, ret.size());
+    e.append(ret);
+  }
+
+  /// @brief 1命令を機械語に変換する。
+  /// @param e 出力先
+  /// @param inst 命令の第1バイト
+  /// @param operand 命令の第2バイト
+  /// @param next 次の命令の番地
+  /// @param states この命令までのステート数
+  /// @return 変換できなければ false（何も出力しない）
+  static bool emitInst(X64Emitter &e, const uint8_t inst, const uint8_t operand,
+                       const uint8_t next, const uint16_t states) {
+    using E = X64Emitter;
+    // x86-64 の 0x80 命令の拡張コードと r/m8, r8 形式の命令コード (ADD ~ XOR)
+    static constexpr std::array<uint8_t, 6> AluExts = {0, 5, 7, 4, 1, 6};
+    static constexpr std::array<uint8_t, 6> AluOpcodes = {0x00, 0x28, 0x38,
+                                                          0x20, 0x08, 0x30};
+    // x86-64 の 0xD0 命令の拡張コード (SHLA, SHLL, SHRA, SHRL)
+    static constexpr std::array<uint8_t, 4> ShiftExts = {4, 4, 7, 5};
+    const uint8_t op = static_cast<uint8_t>((inst >> 4) & 0x0F);
+    const uint8_t gr = static_cast<uint8_t>((inst >> 2) & 0x03);
+    const uint8_t xr = static_cast<uint8_t>(inst & 0x03);
+    const uint8_t r = JitRegs[gr];
+    bool ok = true;
+    switch (op) {
+    case 0x0: // NO
+      ok = inst == 0x00;
+      break;
+    case 0x1: // LD
+      if (xr == 0b11) {
+        e.movRI8(r, operand);
+      } else {
+        emitAddr(e, xr, operand);
+        e.loadIdx8(r, E::R15, E::RAX);
+      }
+      break;
+    case 0x2: // ST
+      if ((ok = xr != 0b11)) {
+        emitAddr(e, xr, operand);
+        e.movRR32(E::RSI, E::RAX);
+        e.movzxRR8(E::RDX, r);
+        emitWriteMem(e);
+        emitReturnIfInvalidated(e, next, states);
+      }
+      break;
+    case 0x3: // ADD
+    case 0x4: // SUB
+    case 0x5: // CMP
+    case 0x6: // AND
+    case 0x7: // OR
+    case 0x8: // XOR
+      if (xr == 0b11) {
+        e.aluRI8(AluExts[op - 0x3], r, operand);
+      } else {
+        emitAddr(e, xr, operand);
+        e.loadIdx8(E::RCX, E::R15, E::RAX);
+        e.aluRR8(AluOpcodes[op - 0x3], r, E::RCX);
+      }
+      emitFlags(e);
+      break;
+    case 0x9: // Shift
+      e.shiftR8(ShiftExts[xr], r);
+      emitFlags(e);
+      break;
+    case 0xA: // Jump 1
+    case 0xB: // Jump 2
+      if ((ok = xr != 0b11)) {
+        emitJump(e, op, gr, xr, operand, next, states);
+      }
+      break;
+    case 0xC: // IN, OUT
+      if (IOAddrEnd <= operand) {
+        ok = false;
+      } else if (xr == 0b00) {
+        e.movRR64(E::RDI, E::RBP);
+        e.movRI32(E::RSI, operand);
+        e.movRI64(E::RAX, reinterpret_cast<uint64_t>(&TeC::JitIn));
+        e.callR(E::RAX);
+        e.movRR8(r, E::RAX);
+      } else if ((ok = xr == 0b11 && not OutEndsHorizon(operand))) {
+        e.movRR64(E::RDI, E::RBP);
+        e.movRI32(E::RSI, operand);
+        e.movzxRR8(E::RDX, r);
+        e.movRI64(E::RAX, reinterpret_cast<uint64_t>(&TeC::JitOut));
+        e.callR(E::RAX);
+      }
+      break;
+    case 0xD:
+      if (xr == 0b00) { // PUSH
+        e.movzxRR8(E::RSI, JitRegs[3]);
+        e.decR8(E::RSI);
+        e.movzxRR8(E::RDX, r);
+        emitWriteMem(e);
+        e.decR8(JitRegs[3]);
+        emitReturnIfInvalidated(e, next, states);
+      } else if (xr == 0b10) { // POP
+        e.movzxRR8(E::RAX, JitRegs[3]);
+        e.loadIdx8(r, E::R15, E::RAX);
+        e.incR8(JitRegs[3]);
+      } else {
+        ok = false;
+      }
+      break;
+    case 0xE:
+      if ((ok = inst == 0xEC)) { // RET
+        e.movzxRR8(E::RAX, JitRegs[3]);
+        e.loadIdx8(E::RAX, E::R15, E::RAX);
+        e.incR8(JitRegs[3]);
+        e.storeRbp8(offsetof(JitContext, pc), E::RAX);
+        emitReturn(e, states);
+      }
+      break;
+    default: // HALT など
+      ok = false;
+      break;
+    }
+    return ok;
+  }
+
+  /// @brief ジャンプ命令を機械語に変換する。
+  /// @note emitInst() と同じ引数に加えて OP, GR, XR を受け取る。
+  static void emitJump(X64Emitter &e, const uint8_t op, const uint8_t gr,
+                       const uint8_t xr, const uint8_t operand,
+                       const uint8_t next, const uint16_t states) {
+    using E = X64Emitter;
+    // 分岐先を PC に設定して戻る
+    const auto jump = [&](X64Emitter &out) {
+      if (xr == 0b00) {
+        out.storeRbpI8(offsetof(JitContext, pc), operand);
+      } else {
+        emitAddr(out, xr, operand);
+        out.storeRbp8(offsetof(JitContext, pc), E::RAX);
+      }
+      emitReturn(out, states);
+    };
+    if (gr == 0b00) {
+      if (op == 0xB) { // CALL
+        e.decR8(JitRegs[3]);
+        e.movzxRR8(E::RSI, JitRegs[3]);
+        e.movRI32(E::RDX, next);
+        emitWriteMem(e);
+      }
+      jump(e);
+    } else {
+      const uint8_t flg = gr == 0b01   ? offsetof(JitContext, z)
+                          : gr == 0b10 ? offsetof(JitContext, c)
+                                       : offsetof(JitContext, s);
+      X64Emitter taken;
+      jump(taken);
+      e.cmpRbpI8(flg, 0);
+      // Jump 1 はフラグが 0 のとき、Jump 2 はフラグが 1 のとき分岐しない
+      e.jcc8(op == 0xA ? E::E : E::NE, taken.size());
+      e.append(taken);
+      e.storeRbpI8(offsetof(JitContext, pc), next);
+      emitReturn(e, states);
+    }
+  }
+#endif
+
+  /// @brief スレッデッドコードで指定したステート数の命令を実行する。
+  /// @param maxStates 実行する最大ステート数
+  /// @return 実行したステート数
+  /// @note clock() と同様に、少なくとも1命令は実行する。
+  uint64_t clockThreaded(const uint64_t maxStates) noexcept {
+    uint64_t states = 0;
+#if defined(__GNUC__)
+    // 命令の第1バイトごとの実行ラベル
+#define TEC_LABEL(inst) &&exec_##inst,
+    static const void *const Labels[256] = {TEC_FOR_EACH_INST(TEC_LABEL)};
+#undef TEC_LABEL
+    // 次の命令の実行ラベルへ直接分岐する
+#define TEC_DISPATCH() goto *Labels[readMem(m_state.pc)]
+#define TEC_LABEL(inst)                                                        \
+  exec_##inst : states += stepThreadedOrRom<inst>(states);                     \
+  if (m_ctrl.horizon <= states) {                                              \
+    if (isClockDone(states, maxStates)) {                                      \
+      return states;                                                           \
+    }                                                                          \
+    beginHorizon(states, maxStates);                                           \
+  }                                                                            \
+  TEC_DISPATCH();
+    beginHorizon(states, maxStates);
+    TEC_DISPATCH();
+    TEC_FOR_EACH_INST(TEC_LABEL)
+#undef TEC_LABEL
+#undef TEC_DISPATCH
+#else
+    do {
+      beginHorizon(states, maxStates);
+      do {
+        switch (readMem(m_state.pc)) {
+#define TEC_CASE(inst)                                                         \
+  case inst:                                                                   \
+    states += stepThreadedOrRom<inst>(states);                                 \
+    break;
+          TEC_FOR_EACH_INST(TEC_CASE)
+#undef TEC_CASE
+        }
+      } while (states < m_ctrl.horizon);
+    } while (not isClockDone(states, maxStates));
+#endif
+    return states;
+  }
+
+  /// @brief stepThreaded() と同様に実行する。ただし、PC が ROM の READ
+  /// ルーチンの入口なら runRomRead() で実行する。
+  /// @tparam Inst 命令の第1バイト
+  /// @param states clock() を呼び出してから実行したステート数
+  /// @return 実行に要したステート数（エラーの場合は0）
+  template <uint8_t Inst>
+  uint16_t stepThreadedOrRom(const uint64_t states) noexcept {
+    // READ ルーチンの最初の命令（IN G0,3）の場合だけ PC を調べる
+    if constexpr (Inst == RomReadInst) {
+      if (m_state.pc == RomReadAddr) {
+        return runRomRead(states);
+      }
+    }
+    return stepThreaded<Inst>();
+  }
+
+  /// @brief 番地と第2バイトが決まった命令を1つ実行する（tec2c 用）。
+  /// @tparam Inst 命令の第1バイト
+  /// @tparam Operand 命令の第2バイト（1バイト命令では使わない）
+  /// @tparam Next 次の命令の番地
+  /// @return 実行に要したステート数（エラーの場合は0）
+  template <uint8_t Inst, uint8_t Operand, uint8_t Next>
+  uint8_t stepConst() noexcept {
+    m_state.pc = Next;
+    exec<Inst>(Operand);
+    constexpr uint8_t States = StatesOf(Inst, Operand);
+    // 実行したステート数（= クロック数）をカウント
+    m_state.tmrClkCnt += States;
+    return States;
+  }
+
+  /// @brief 第1バイトが Inst の命令を1つ実行する（スレッデッドコード用）。
+  /// @tparam Inst 命令の第1バイト
+  /// @return 実行に要したステート数（エラーの場合は0）
+  template <uint8_t Inst> uint8_t stepThreaded() noexcept {
+    const uint8_t operand = readMem(static_cast<uint8_t>(m_state.pc + 1));
+    m_state.pc = static_cast<uint8_t>(m_state.pc + FormatOf(Inst).size);
+    exec<Inst>(operand);
+    const uint8_t states = StatesOf(Inst, operand);
+    // 実行したステート数（= クロック数）をカウント
+    m_state.tmrClkCnt += states;
+    return states;
+  }
+
+  /// @brief 入出力アドレスの上限（これ以上はエラー）
+  static constexpr uint8_t IOAddrEnd = 0x10;
+
+  /// @brief OUT 命令がタイマか割り込みの状態を変える入出力アドレスか判定する。
+  /// @param addr 入出力アドレス
+  /// @return SIO-CTRL, TMR-CTRL, Console STI なら true
+  /// @note
+  /// それ以外のアドレス（ブザー、パラレル出力、TMR周期など）への出力は
+  /// 区間（beginHorizon() を参照）の終わりを変えないので、区間を打ち切らず、
+  /// 基本ブロックも終えない。タイマも割り込みも使わないプログラムは、
+  /// 出力のたびにタイマと割り込みを処理しなくて済む。
+  static constexpr bool OutEndsHorizon(const uint8_t addr) noexcept {
+    return addr == 0x3 || addr == 0x5 || addr == 0x6;
+  }
+
+  /// @brief 命令の形式
+  struct InstFormat {
+    /// @brief 命令長（フェッチするバイト数）
+    uint8_t size;
+    /// @brief 実行に要するステート数（エラーの場合は0）
+    uint8_t states;
+    /// @brief 入出力命令か（入出力アドレスが不正ならエラーになる）
+    bool io;
+  };
+
+  /// @brief 命令の第1バイトから形式を求める。
+  /// @param inst 命令の第1バイト
+  /// @return 形式
+  static constexpr InstFormat FormatOf(const uint8_t inst) noexcept {
+    const uint8_t op = static_cast<uint8_t>((inst >> 4) & 0x0F);
+    const uint8_t gr = static_cast<uint8_t>((inst >> 2) & 0x03);
+    const uint8_t xr = static_cast<uint8_t>(inst & 0x03);
+    // 不正な命令（オペランドを読まないもの）
+    InstFormat fmt{.size = 1, .states = 0, .io = false};
+    switch (op) {
+    case 0x0: // NO
+      if (gr == 0b00 && xr == 0b00) {
+        fmt.states = 2;
+      }
+      break;
+    case 0x1: // LD
+    case 0x3: // ADD
+    case 0x4: // SUB
+    case 0x5: // CMP
+    case 0x6: // AND
+    case 0x7: // OR
+    case 0x8: // XOR
+      fmt = {.size = 2, .states = 4, .io = false};
+      break;
+    case 0x2: // ST
+    case 0xA: // Jump 1
+      if (xr != 0b11) {
+        fmt = {.size = 2, .states = 3, .io = false};
+      }
+      break;
+    case 0x9: // Shift
+      fmt.states = 3;
+      break;
+    case 0xB: // Jump 2
+      if (xr != 0b11) {
+        // CALL は戻り番地の退避に1ステート多くかかる
+        fmt = {.size = 2,
+               .states = static_cast<uint8_t>(gr == 0b00 ? 4 : 3),
+               .io = false};
+      }
+      break;
+    case 0xC:
+      if (xr == 0b00) { // IN
+        fmt = {.size = 2, .states = 4, .io = true};
+      } else if (xr == 0b11) { // OUT
+        fmt = {.size = 2, .states = 3, .io = true};
+      }
+      break;
+    case 0xD:
+      if (xr == 0b00) { // PUSH
+        fmt.states = 3;
+      } else if (xr == 0b10) { // POP
+        fmt.states = 4;
+      }
+      break;
+    case 0xE:
+      if (inst == 0xE0 || inst == 0xE3 || inst == 0xEC) { // EI, DI, RET
+        fmt.states = 3;
+      } else if (inst == 0xEF) { // RETI
+        fmt.states = 4;
+      }
+      break;
+    case 0xF: // HALT
+      break;
+    }
+    return fmt;
+  }
+
+  /// @brief 命令の実行に要するステート数を求める。
+  /// @param inst 命令の第1バイト
+  /// @param operand 命令の第2バイト
+  /// @return ステート数（エラーの場合は0）
+  static constexpr uint8_t StatesOf(const uint8_t inst,
+                                    const uint8_t operand) noexcept {
+    const InstFormat fmt = FormatOf(inst);
+    return fmt.io && IOAddrEnd <= operand ? 0 : fmt.states;
+  }
+
+  /// @brief READ ルーチンの最初の命令（IN G0,3）の第1バイト
+  static constexpr uint8_t RomReadInst = 0xC0;
+
+  /// @brief ROM の READ ルーチンを、命令を解釈せずに実行する。
+  /// @param states clock() を呼び出してから実行したステート数
+  /// @return 実行に要したステート数（エラーの場合は0）
+  /// @note PC が RomReadAddr のときに呼び出す。ROM は書き換えられないので、
+  /// ルーチンは常に次の命令列である。
+  /// @code
+  /// READ IN  G0,3     ; SIO-STAT
+  ///      AND G0,#40H  ; 受信済みか
+  ///      JZ  READ
+  ///      IN  G0,2     ; SIO-DATA
+  ///      RET
+  /// @endcode
+  /// @note
+  /// 受信バッファは区間の中では変わらないので、受信待ちのループは区間内に
+  /// 始まる周回の分をまとめて実行する。各命令が区間内に始まる場合だけまとめて
+  /// 実行し、そうでなければ1命令だけ実行して、インタプリタと同じ結果にする。
+  uint16_t runRomRead(const uint64_t states) noexcept {
+    // 受信待ちループ（IN G0,3 / AND G0,#40H / JZ READ）の1周のステート数と
+    // 最後の JZ READ を除いたステート数
+    constexpr uint8_t PollStates = StatesOf(RomReadInst, 0x03) +
+                                   StatesOf(0x63, 0x40) +
+                                   StatesOf(0xA4, RomReadAddr);
+    constexpr uint8_t PollHeadStates =
+        PollStates - StatesOf(0xA4, RomReadAddr);
+    // 受信済みの場合の全体のステート数と最後の RET を除いたステート数
+    constexpr uint8_t HeadStates = PollStates + StatesOf(RomReadInst, 0x02);
+    constexpr uint8_t AllStates = HeadStates + StatesOf(0xEC, 0x00);
+    if ((m_state.intReq & Int1Bit) == 0) {
+      if (m_ctrl.horizon <= states + PollHeadStates) {
+        return stepDecoded();
+      }
+      // 最後の JZ READ が区間内に始まる周回の数
+      const uint64_t polls =
+          (m_ctrl.horizon - states - PollHeadStates - 1) / PollStates + 1;
+      const uint16_t n = static_cast<uint16_t>(polls * PollStates);
+      // AND G0,#40H の結果（0）が G0 とフラグに残り、JZ READ で入口に戻る
+      m_state.g0 = 0x00;
+      m_state.flg = 0x00;
+      m_state.tmrClkCnt += n;
+      return n;
+    }
+    if (m_ctrl.horizon <= states + HeadStates) {
+      return stepDecoded();
+    }
+    // AND G0,#40H のフラグ（結果は 40H）は IN G0,2 で変わらずに残る
+    m_state.flg = 0x40;
+    m_state.g0 = in(0x02);
+    m_state.pc = readMem(m_state.sp++);
+    m_state.tmrClkCnt += AllStates;
+    return AllStates;
+  }
+
+  /// @brief 第1バイトごとの実行関数の表を作る。
+  template <size_t... Insts>
+  static constexpr std::array<Exec, 256>
+  MakeExecTable(std::index_sequence<Insts...>) noexcept {
+    return {&TeC::Handler<static_cast<uint8_t>(Insts)>...};
+  }
+
+  /// @brief exec() を通常の関数として呼び出せるようにする。
+  /// @tparam Inst 命令の第1バイト
+  template <uint8_t Inst>
+  static void Handler(TeC &tec, const uint8_t operand) noexcept {
+    tec.exec<Inst>(operand);
+  }
+
+  /// @brief addr 番地から命令を解読する。
+  /// @param addr 命令のアドレス
+  /// @return 解読済み命令
+  DecodedInst decode(const uint8_t addr) const noexcept {
+    static constexpr std::array<Exec, 256> Execs =
+        MakeExecTable(std::make_index_sequence<256>{});
+    const uint8_t inst = readMem(addr);
+    const uint8_t operand = readMem(static_cast<uint8_t>(addr + 1));
+    DecodedInst decoded{.exec = Execs[inst],
+                        .fused = nullptr,
+                        .operand = operand,
+                        .size = FormatOf(inst).size,
+                        .states = StatesOf(inst, operand),
+                        .valid = true,
+                        .span = FormatOf(inst).size,
+                        .fusedImm = 0,
+                        .fusedTarget = 0,
+                        .fusedStates = 0,
+                        .fusedHeadStates = 0};
+    fuse(addr, decoded);
+    return decoded;
+  }
+
+  /// @brief 融合命令のバイト数（2バイト命令 x 3）
+  static constexpr uint8_t FusedSize = 6;
+
+  /// @brief 融合命令の実行関数の表を作る。
+  /// @tparam Inst1 1命令目の第1バイト（GR は 0）
+  /// @tparam Inst2 2命令目の第1バイト（GR は 0）
+  /// @note 添字は GR（2ビット）と分岐命令の OP の最下位ビットと GR を並べたもの
+  template <uint8_t Inst1, uint8_t Inst2, size_t... Is>
+  static constexpr std::array<FusedExec, 32>
+  MakeFusedTable(std::index_sequence<Is...>) noexcept {
+    return {&TeC::FusedHandler<
+        static_cast<uint8_t>(Inst1 | ((Is >> 3) << 2)),
+        static_cast<uint8_t>(Inst2 | ((Is >> 3) << 2)),
+        static_cast<uint8_t>(0xA0 | ((Is & 0x07) << 2))>...};
+  }
+
+  /// @brief 3命令を続けて実行する（融合命令）。
+  /// @tparam Inst1, Inst2, Inst3 各命令の第1バイト
+  template <uint8_t Inst1, uint8_t Inst2, uint8_t Inst3>
+  static void FusedHandler(TeC &tec, const DecodedInst &inst) noexcept {
+    // 3命令とも2バイト命令で、分岐しなければ次の命令へ進む
+    tec.m_state.pc = static_cast<uint8_t>(tec.m_state.pc + FusedSize);
+    tec.exec<Inst1>(inst.operand);
+    tec.exec<Inst2>(inst.fusedImm);
+    tec.exec<Inst3>(inst.fusedTarget);
+  }
+
+  /// @brief addr 番地から始まる3命令が入出力待ちの定型なら、融合命令を設定する。
+  /// @param addr 命令のアドレス
+  /// @param decoded addr 番地の解読済み命令
+  /// @note
+  /// 次の定型を融合する（g は同じレジスタ、Jcc は CALL 以外のダイレクト）。
+  /// - IN g,p / AND g,#imm / Jcc a（SIOの状態などを待つ）
+  /// - LD g,[b] / CMP g,#imm / Jcc a（割り込み処理が書き換えるフラグを待つ）
+  void fuse(const uint8_t addr, DecodedInst &decoded) const noexcept {
+    static constexpr std::array<FusedExec, 32> FusedIns =
+        MakeFusedTable<0xC0, 0x63>(std::make_index_sequence<32>{});
+    static constexpr std::array<FusedExec, 32> FusedLds =
+        MakeFusedTable<0x10, 0x53>(std::make_index_sequence<32>{});
+    const uint8_t inst = readMem(addr);
+    const uint8_t inst2 = readMem(static_cast<uint8_t>(addr + 2));
+    const uint8_t inst3 = readMem(static_cast<uint8_t>(addr + 4));
+    const uint8_t gr = static_cast<uint8_t>(inst & 0x0C);
+    if ((inst3 & 0xE3) != 0xA0 || inst3 == 0xB0) { // Jcc a 以外
+      return;
+    }
+    // レジスタと分岐条件で特殊化した実行関数の添字
+    const size_t i = static_cast<size_t>((gr << 1) | ((inst3 >> 2) & 0x07));
+    if (inst == (0xC0 | gr) && decoded.operand < IOAddrEnd &&
+        inst2 == (0x63 | gr)) {
+      decoded.fused = FusedIns[i];
+    } else if (inst == (0x10 | gr) && inst2 == (0x53 | gr)) {
+      decoded.fused = FusedLds[i];
+    } else {
+      return;
+    }
+    decoded.span = FusedSize;
+    decoded.fusedImm = readMem(static_cast<uint8_t>(addr + 3));
+    decoded.fusedTarget = readMem(static_cast<uint8_t>(addr + 5));
+    decoded.fusedHeadStates =
+        static_cast<uint8_t>(decoded.states + StatesOf(inst2, 0));
+    decoded.fusedStates =
+        static_cast<uint8_t>(decoded.fusedHeadStates + StatesOf(inst3, 0));
+  }
+
+  /// @brief GRで指定されたレジスタを参照する。
+  /// @tparam Gr GR
+  /// @return レジスタへの参照
+  template <uint8_t Gr> uint8_t &reg() noexcept {
+    if constexpr (Gr == 0b00) {
+      return m_state.g0;
+    } else if constexpr (Gr == 0b01) {
+      return m_state.g1;
+    } else if constexpr (Gr == 0b10) {
+      return m_state.g2;
+    } else {
+      return m_state.sp;
+    }
+  }
+
+  /// @brief オペランドの実効アドレスを求める。
+  /// @tparam Xr XR
+  /// @param operand 命令の第2バイト
+  /// @return アドレス
+  template <uint8_t Xr>
+  uint8_t operandAddr(const uint8_t operand) const noexcept {
+    if constexpr (Xr == 0b00) { // ダイレクト
+      return operand;
+    } else if constexpr (Xr == 0b01) { // G1インデクスド
+      return static_cast<uint8_t>(operand + m_state.g1);
+    } else if constexpr (Xr == 0b10) { // G2インデクスド
+      return static_cast<uint8_t>(operand + m_state.g2);
+    } else { // 即値（この関数では求められない）
+      BUG("TeC::operandAddr(uint8_t) const noexcept");
+    }
+  }
+
+  /// @brief オペランドの値を求める。
+  /// @tparam Xr XR
+  /// @param operand 命令の第2バイト
+  /// @return 値
+  template <uint8_t Xr>
+  uint8_t operandValue(const uint8_t operand) const noexcept {
+    if constexpr (Xr == 0b11) { // 即値
+      return operand;
+    } else {
+      return readMem(operandAddr<Xr>(operand));
+    }
+  }
+
+  /// @brief 演算を行い、フラグを設定する。
+  /// @tparam Op 命令のOP（ADD, SUB, CMP, AND, OR, XOR）
+  /// @param a 左オペランド
+  /// @param b 右オペランド
+  /// @return 演算結果
+  template <uint8_t Op> uint8_t alu(const uint8_t a, const uint8_t b) noexcept {
+    if constexpr (Op == 0x3 || Op == 0x4 || Op == 0x5) { // ADD, SUB, CMP
+      const uint16_t val =
+          Op == 0x3 ? static_cast<uint16_t>(a + b)
+                    : static_cast<uint16_t>(a - b);
+      m_state.flg = val & 0x1FF;
+      return static_cast<uint8_t>(val & 0xFF);
+    } else { // AND, OR, XOR
+      const uint8_t val = Op == 0x6   ? a & b
+                          : Op == 0x7 ? a | b
+                                      : a ^ b;
+      m_state.flg = val;
+      return val;
+    }
+  }
+
+  /// @brief シフト演算を行い、フラグを設定する。
+  /// @tparam Xr XR（SHLA, SHLL, SHRA, SHRL）
+  /// @param val 値
+  /// @return 演算結果
+  template <uint8_t Xr> uint8_t shift(const uint8_t val) noexcept {
+    if constexpr (Xr == 0b00 || Xr == 0b01) { // SHLA, SHLL
+      // 押し出されたビットがそのままビット8 (C) になる
+      m_state.flg = static_cast<uint16_t>(val << 1);
+    } else if constexpr (Xr == 0b10) { // SHRA
+      m_state.flg = static_cast<uint16_t>(((val & 0x01) << 8) | (val & 0x80) |
+                                          (val >> 1));
+    } else { // SHRL
+      m_state.flg = static_cast<uint16_t>(((val & 0x01) << 8) | (val >> 1));
+    }
+    return static_cast<uint8_t>(m_state.flg & 0xFF);
+  }
+
+  /// @brief ジャンプ命令の分岐条件を判定する。
+  /// @tparam Op 命令のOP（Jump 1 または Jump 2）
+  /// @tparam Gr GR
+  /// @return 分岐する場合は true
+  template <uint8_t Op, uint8_t Gr> bool cond() const noexcept {
+    if constexpr (Gr == 0b00) { // JMP, CALL
+      return true;
+    } else {
+      const bool flg = Gr == 0b01 ? flgZ() : Gr == 0b10 ? flgC() : flgS();
+      return Op == 0xA ? flg : not flg;
+    }
+  }
+
+  /// @brief 入出力装置から値を読む（IN命令）。
+  /// @param addr 入出力アドレス
+  /// @return 値
+  uint8_t in(const uint8_t addr) noexcept {
+    uint8_t val = 0x00;
+    switch (addr) {
+    case 0x0: // Data-Sw
+    case 0x1: // Data-Sw
+      val = m_state.dataSW;
+      break;
+    case 0x2: // SIO-DATA
+      val = m_state.rxReg;
+      m_state.intReq &= static_cast<uint8_t>(~Int1Bit);
+      break;
+    case 0x3: // SIO-STAT
+      val = static_cast<uint8_t>(
+          ((m_state.intReq & Int1Bit) != 0 ? 0x40 : 0x00) |
+          ((m_state.intReq & Int2Bit) != 0 ? 0x80 : 0x00));
+      break;
+    case 0x4: // TMR現在値
+      val = m_state.tmrCnt;
+      break;
+    case 0x5: // TMR-Stat
+      val = m_state.tmrElapsed ? 0x80 : 0x00;
+      m_state.tmrElapsed = false;
+      break;
+    case 0x7:
+      val = m_state.parallelIn;
+      break;
+    case 0x8:
+    case 0x9:
+    case 0xA:
+    case 0xB:
+      val = m_state.adcChs[addr - 0x8];
+      break;
+    case 0x6:
+    case 0xC:
+    case 0xD:
+    case 0xE:
+    case 0xF:
+      val = 0x00;
+      break;
+    default:
+      BUG("TeC::in(uint8_t) noexcept");
+      break;
+    }
+    return val;
+  }
+
+  /// @brief 入出力装置へ値を書き込む（OUT命令）。
+  /// @param addr 入出力アドレス
+  /// @param val 値
+  void out(const uint8_t addr, const uint8_t val) noexcept {
+    switch (addr) {
+    case 0x0: // BUZ
+      m_state.buz = (val & 0x01) != 0;
+      break;
+    case 0x1: // SPK
+      m_state.spk = (val & 0x01) != 0;
+      break;
+    case 0x2: // SIO-DATA
+      m_state.txReg = val;
+      m_state.intReq &= static_cast<uint8_t>(~Int2Bit);
+      break;
+    case 0x3: // SIO-CTRL
+      m_state.intMask =
+          static_cast<uint8_t>((m_state.intMask & ~(Int1Bit | Int2Bit)) |
+                               ((val & 0x80) != 0 ? Int2Bit : 0) |
+                               ((val & 0x40) != 0 ? Int1Bit : 0));
+      break;
+    case 0x4: // TMR周期
+      m_state.tmrPeriod = val;
+      break;
+    case 0x5: // TMR-CTRL
+      ++m_ctrl.tmrCtrlWrites;
+      m_state.intMask = static_cast<uint8_t>((m_state.intMask & ~Int0Bit) |
+                                             ((val & 0x80) != 0 ? Int0Bit : 0));
+      if ((m_state.tmrEna = (val & 0x01) != 0)) {
+        m_state.tmrElapsed = false;
+        // タイマ開始時にカウンタをリセット
+        m_state.tmrCnt = 0x00;
+      }
+      break;
+    case 0x6: // Console STI
+      m_state.intMask = static_cast<uint8_t>((m_state.intMask & ~Int3Bit) |
+                                             ((val & 0x01) != 0 ? Int3Bit : 0));
+      break;
+    case 0x7: // PIO-OUTPUT
+      m_state.parallelOut = val;
+      break;
+    case 0xC: // PIO-Ctrl
+      if ((m_state.extParallelOutEna = (val & 0x80) != 0)) {
+        m_state.extParallelOut = val & 0x0F;
+      }
+      break;
+    case 0x8:
+    case 0x9:
+    case 0xA:
+    case 0xB:
+    case 0xD:
+    case 0xE:
+    case 0xF:
+      break;
+    default:
+      BUG("TeC::out(uint8_t, uint8_t) noexcept");
+      break;
+    }
+  }
+
+  /// @brief 命令を実行する。
+  /// @tparam Inst 命令の第1バイト
+  /// @param operand 命令の第2バイト（1バイト命令では使わない）
+  /// @note プログラムカウンタを命令長の分だけ進めてから呼び出す。
+  template <uint8_t Inst> void exec(const uint8_t operand) noexcept {
+    constexpr uint8_t Op = (Inst >> 4) & 0x0F;
+    constexpr uint8_t Gr = (Inst >> 2) & 0x03;
+    constexpr uint8_t Xr = Inst & 0x03;
+    if constexpr (Inst == 0x00) { // NO
+    } else if constexpr (Op == 0x1) { // LD
+      reg<Gr>() = operandValue<Xr>(operand);
+    } else if constexpr (Op == 0x2 && Xr != 0b11) { // ST
+      writeMem(operandAddr<Xr>(operand), reg<Gr>());
+    } else if constexpr (0x3 <= Op && Op <= 0x8) { // ADD ~ XOR
+      const uint8_t val = alu<Op>(reg<Gr>(), operandValue<Xr>(operand));
+      if constexpr (Op != 0x5) { // CMP は結果を書き込まない
+        reg<Gr>() = val;
+      }
+    } else if constexpr (Op == 0x9) { // Shift
+      reg<Gr>() = shift<Xr>(reg<Gr>());
+    } else if constexpr ((Op == 0xA || Op == 0xB) && Xr != 0b11) { // Jump
+      const uint8_t addr = operandAddr<Xr>(operand);
+      if constexpr (Op == 0xB && Gr == 0b00) { // CALL
+        writeMem(--m_state.sp, m_state.pc);
+      }
+      if (cond<Op, Gr>()) {
+        m_state.pc = addr;
+      }
+    } else if constexpr (Op == 0xC && (Xr == 0b00 || Xr == 0b11)) { // IN, OUT
+      if (IOAddrEnd <= operand) {
+        error();
+      } else if constexpr (Xr == 0b00) {
+        reg<Gr>() = in(operand);
+      } else {
+        out(operand, reg<Gr>());
+        if (OutEndsHorizon(operand)) {
+          endHorizon();
+        }
+      }
+    } else if constexpr (Op == 0xD && Xr == 0b00) { // PUSH
+      writeMem(static_cast<uint8_t>(m_state.sp - 1), reg<Gr>());
+      --m_state.sp;
+    } else if constexpr (Op == 0xD && Xr == 0b10) { // POP
+      reg<Gr>() = readMem(m_state.sp);
+      ++m_state.sp;
+    } else if constexpr (Inst == 0xE0) { // EI
+      m_state.intEna = true;
+      endHorizon();
+    } else if constexpr (Inst == 0xE3) { // DI
+      m_state.intEna = false;
+    } else if constexpr (Inst == 0xEC) { // RET
+      m_state.pc = readMem(m_state.sp++);
+    } else if constexpr (Inst == 0xEF) { // RETI
+      const uint8_t flg = readMem(m_state.sp++);
+      m_state.intEna = (flg & 0x80) != 0;
+      endHorizon();
+      m_state.flg = TeCState::FlgExplicit | (flg & 0x07);
+      m_state.pc = readMem(m_state.sp++);
+    } else if constexpr (Inst == 0xFF) { // HALT
+      m_state.run = false;
+      endHorizon();
+    } else { // 不正な命令
+      error();
+    }
+  }
+};
+
+/// @brief 命令のタイプ
+enum class EventType : uint8_t {
+  /// @brief レジスタへの書き込み
+  SetReg,
+  /// @brief フラグへの書き込み
+  SetFlg,
+  /// @brief メモリへの書き込み
+  SetMM,
+  /// @brief データスイッチの設定
+  SetDataSW,
+  /// @brief 実行開始
+  Run,
+  /// @brief 実行停止
+  Stop,
+  /// @brief シリアル入力への書き込み
+  Serial,
+  /// @brief ファイルの内容のシリアル入力への書き込み
+  SerialFile,
+  /// @brief （前回のイベントから）一定のステート数以上待機
+  WaitStates,
+  /// @brief シリアル入力が全て受け取られるまで待機
+  WaitSerial,
+  /// @brief 実行停止まで待機
+  WaitStop,
+  /// @brief （以降に）実行するステート数の上限の設定
+  LimitStates,
+  /// @brief コンソール割り込みの発生
+  Write,
+  /// @brief リセット
+  Reset,
+  /// @brief レジスタの出力
+  PrintReg,
+  /// @brief フラグの出力
+  PrintFlg,
+  /// @brief メモリの出力
+  PrintMM,
+  /// @brief ブザーの出力
+  PrintBuz,
+  /// @brief スピーカの出力
+  PrintSpk,
+  /// @brief RUNランプの出力
+  PrintRun,
+  /// @brief シリアルモード
+  SetSerialMode,
+  /// @brief プリントモード
+  SetPrintMode,
+  /// @brief アナログ入力
+  Analog,
+  /// @brief パラレル入力への書き込み
+  ParallelWrite,
+  /// @brief パラレル出力の読み取り
+  PrintParallel,
+  /// @brief 拡張パラレル出力の読み取り
+  PrintExtParallel,
+  /// @brief 状態のスナップショットのファイルへの保存
+  Save,
+  /// @brief 状態のスナップショットのファイルからの復元
+  Load,
+};
+
+/// @brief 出力モード
+enum class OutputMode : uint8_t {
+  /// @brief そのまま
+  Raw,
+  /// @brief 16進数 (XX) 1オクテットごとに空白, 8オクテットで改行
+  Hex,
+  /// @brief TeC形式 (0XXH) 1オクテットごとに改行
+  TeC,
+  /// @brief 符号付き10進 1オクテットごとに改行
+  SDEC,
+  /// @brief 符号なし10進 1オクテットごとに改行
+  UDEC
+};
+
+[[nodiscard]] static inline std::optional<OutputMode>
+StrToOutputMode(const std::string &s) {
+  std::optional<OutputMode> mode = std::nullopt;
+  if (s == "RAW") {
+    mode = OutputMode::Raw;
+  } else if (s == "HEX") {
+    mode = OutputMode::Hex;
+  } else if (s == "TEC") {
+    mode = OutputMode::TeC;
+  } else if (s == "SDEC") {
+    mode = OutputMode::SDEC;
+  } else if (s == "UDEC") {
+    mode = OutputMode::UDEC;
+  }
+  return mode;
+}
+
+/// @brief シリアル出力モード
+using SerialMode = OutputMode;
+
+/// @brief 表示モード
+using PrintMode = OutputMode;
+
+/// @brief シリアル出力モードの初期値
+static constexpr SerialMode DefaultSerialMode = SerialMode::Raw;
+
+/// @brief 表示モードの初期値
+static constexpr PrintMode DefaultPrintMode = PrintMode::UDEC;
+
+/// @brief イベント処理
+struct Event {
+  Event(const EventType type) noexcept : type(type) {}
+
+  virtual ~Event() = default;
+
+  EventType type;
+};
+
+struct PrintFlgEvent : public Event {
+  PrintFlgEvent(const Flg flg) noexcept
+      : Event(EventType::PrintFlg), flg(flg) {}
+
+  Flg flg;
+};
+
+struct PrintRegEvent : public Event {
+  PrintRegEvent(const Reg reg) noexcept
+      : Event(EventType::PrintReg), reg(reg) {}
+
+  Reg reg;
+};
+
+struct PrintMMEvent : public Event {
+  PrintMMEvent(const uint8_t addr) noexcept
+      : Event(EventType::PrintMM), addr(addr) {}
+
+  uint8_t addr;
+};
+
+struct SetRegEvent : public Event {
+  SetRegEvent(const Reg reg, uint8_t value) noexcept
+      : Event(EventType::SetReg), reg(reg), value(value) {}
+
+  Reg reg;
+  uint8_t value;
+};
+
+struct SetFlgEvent : public Event {
+  SetFlgEvent(const Flg flg, const bool val) noexcept
+      : Event(EventType::SetFlg), flg(flg), val(val) {}
+
+  Flg flg;
+  bool val;
+};
+
+struct SetMMEvent : public Event {
+  SetMMEvent(const uint8_t addr, const uint8_t val) noexcept
+      : Event(EventType::SetMM), addr(addr), val(val) {}
+
+  uint8_t addr;
+  uint8_t val;
+};
+
+struct SetDataSWEvent : public Event {
+  SetDataSWEvent(const uint8_t val) noexcept
+      : Event(EventType::SetDataSW), val(val) {}
+  uint8_t val;
+};
+
+struct SetSerialModeEvent : public Event {
+  SetSerialModeEvent(const SerialMode mode) noexcept
+      : Event(EventType::SetSerialMode), mode(mode) {}
+
+  SerialMode mode;
+};
+
+struct SetPrintModeEvent : public Event {
+  SetPrintModeEvent(const PrintMode mode) noexcept
+      : Event(EventType::SetPrintMode), mode(mode) {}
+
+  SerialMode mode;
+};
+
+struct SerialEvent : public Event {
+  SerialEvent(std::vector<uint8_t> &&value)
+      : Event(EventType::Serial), value(std::move(value)) {}
+
+  std::vector<uint8_t> value;
+};
+
+struct SerialFileEvent : public Event {
+  SerialFileEvent(std::string &&path)
+      : Event(EventType::SerialFile), path(std::move(path)) {}
+
+  std::string path;
+};
+
+struct SnapshotEvent : public Event {
+  SnapshotEvent(const EventType type, std::string &&path)
+      : Event(type), path(std::move(path)) {}
+
+  std::string path;
+};
+
+struct WaitStatesEvent : public Event {
+  WaitStatesEvent(const uint64_t states) noexcept
+      : Event(EventType::WaitStates), states(states) {}
+
+  uint64_t states;
+};
+
+struct LimitStatesEvent : public Event {
+  LimitStatesEvent(const uint64_t states) noexcept
+      : Event(EventType::LimitStates), states(states) {}
+
+  uint64_t states;
+};
+
+struct AnalogEvent : public Event {
+  AnalogEvent(const uint8_t pin, const uint8_t value) noexcept
+      : Event(EventType::Analog), pin(pin), value(value) {}
+
+  uint8_t pin;
+  uint8_t value;
+};
+
+struct ParallelWriteEvent : public Event {
+  ParallelWriteEvent(const uint8_t value) noexcept
+      : Event(EventType::ParallelWrite), value(value) {}
+
+  uint8_t value;
+};
+
+using EventList = std::vector<std::unique_ptr<Event>>;
+
+/// @brief TCL を読み取り、イベント処理リストを返す。
+/// @param in 入力
+/// @param err エラーメッセージの出力先
+/// @param nameTable 名前表
+/// @return イベント処理リスト（エラーがあれば全て出力して std::nullopt）
+static inline std::optional<EventList>
+ReadInput(std::istream &in, std::ostream &err, const NameTable &nameTable) {
+  // 入力読み取り用
+  struct InputReader {
+    // 入力
+    std::istream &in;
+    // エラーメッセージの出力先
+    std::ostream &err;
+    // 名前表
+    const NameTable &nameTable;
+    // エラーが発生したか
+    bool hasError = false;
+    // 現在の行
+    std::string curLine = "";
+    // 現在の文字の添え字
+    size_t curIdx = 0;
+    // エラーメッセージを出力する（続けて読み取り、全てのエラーを出力する）。
+    void printError(const std::string &msg, const ErrorType type) {
+      WriteError(err, msg, type);
+      hasError = true;
+    }
+    // 空白とコメントを読み飛ばす。
+    void skipSpaceOrComment() {
+      while (curIdx < curLine.size()) {
+        if (std::isspace(curLine[curIdx])) {
+          ++curIdx;
+        } else if (curLine[curIdx] == ';') {
+          curIdx = curLine.size();
+          break;
+        } else {
+          break;
+        }
+      }
+    }
+    // ラベルの開始文字を判定する。
+    [[nodiscard]] bool isLabelStart() {
+      return curIdx < curLine.size() &&
+             (std::isalpha(curLine[curIdx]) || curLine[curIdx] == '_');
+    }
+    // ラベル文字を判定する。
+    [[nodiscard]] bool isLabel() {
+      return curIdx < curLine.size() &&
+             (std::isalnum(curLine[curIdx]) || curLine[curIdx] == '_');
+    }
+    // 1文字判定する。
+    [[nodiscard]] bool isCh(const char ch) {
+      if (curIdx < curLine.size() && curLine[curIdx] == ch) {
+        ++curIdx;
+        return true;
+      }
+      return false;
+    }
+    // ラベルの値を読み取る。
+    [[nodiscard]] bool getLabel(uint8_t &val) {
+      assert(isLabelStart());
+      std::string label;
+      do {
+        label += std::toupper(curLine[curIdx++]);
+      } while (isLabel());
+      val = 0x00;
+      if (const auto nameTableIt = nameTable.find(label);
+          nameTableIt != nameTable.cend()) {
+        val = nameTableIt->second;
+      } else {
+        printError(
+            std::format("ラベルが見つかりません。 (ラベル: \"{}\")", label),
+            ErrorType::Program);
+        return false;
+      }
+      return true;
+    }
+    // 10進数文字を判定する。
+    [[nodiscard]] bool isDigit() {
+      return curIdx < curLine.size() && std::isdigit(curLine[curIdx]);
+    }
+    // 16進数文字を判定する。
+    [[nodiscard]] bool isXDigit() {
+      return curIdx < curLine.size() && std::isxdigit(curLine[curIdx]);
+    }
+    // 数字を読む。
+    [[nodiscard]] bool getNum(uint8_t &val) {
+      assert(isDigit());
+      std::string numStr;
+      bool isHex = false;
+      do {
+        if (not isDigit()) {
+          isHex = true;
+        }
+        numStr += curLine[curIdx++];
+      } while (isXDigit());
+      if (isCh('H') || isCh('h')) {
+        isHex = true;
+      } else if (isHex) {
+        printError("16進数リテラルが不正です。（'H' が必要です。）",
+                   ErrorType::Input);
+        return false;
+      }
+      val = 0x00;
+      try {
+        size_t lastIdx;
+        val =
+            static_cast<uint8_t>(std::stoi(numStr, &lastIdx, isHex ? 16 : 10));
+        if (lastIdx != numStr.size()) {
+          BUG("stoi");
+          return false;
+        }
+      } catch (const std::invalid_argument &e) {
+        BUG("stoi");
+        return false;
+      } catch (const std::out_of_range &e) {
+        printError(std::format("値が大きすぎます。 (値: \"{}\")", numStr),
+                   ErrorType::Input);
+        return false;
+      }
+      return true;
+    }
+    // 値を読む。
+    [[nodiscard]] bool getValue(uint8_t &val) {
+      // 空白を読み飛ばす。
+      skipSpaceOrComment();
+      bool pos = true;
+      if (isCh('+')) { // 正
+        skipSpaceOrComment();
+      } else if (isCh('-')) { // 負
+        skipSpaceOrComment();
+        pos = false;
+      }
+
+      if (isLabelStart()) { // ラベル
+        if (not getLabel(val)) {
+          return false;
+        }
+      } else if (isDigit()) { // 数字
+        if (not getNum(val)) {
+          return false;
+        }
+      } else if (isCh('(')) { // 括弧
+        if (not getAdd(val)) {
+          return false;
+        }
+        skipSpaceOrComment();
+        if (not isCh(')')) {
+          printError("')' が必要です。", ErrorType::Input);
+          return false;
+        }
+      } else if (isCh('\'')) { // 文字定数
+        if (curLine.size() <= curIdx || not std::isprint(curLine[curIdx])) {
+          printError("文字定数が不正です。", ErrorType::Input);
+          return false;
+        }
+        val = static_cast<uint8_t>(curLine[curIdx++]);
+        if (not isCh('\'')) {
+          printError("'\\'' （クォーテーション）が必要です。",
+                     ErrorType::Input);
+          return false;
+        }
+      } else { // エラー
+        printError("値が必要です。", ErrorType::Input);
+        return false;
+      }
+      if (not pos) {
+        val = static_cast<uint8_t>(~val + 1);
+      }
+      return true;
+    }
+    // 乗除算を読む。
+    [[nodiscard]] bool getMul(uint8_t &val) {
+      if (not getValue(val)) {
+        return false;
+      }
+      for (;;) {
+        skipSpaceOrComment();
+        if (isCh('*')) {
+          uint8_t rVal = 0x00;
+          if (not getValue(rVal)) {
+            return false;
+          }
+          val *= rVal;
+        } else if (isCh('/')) {
+          uint8_t rVal = 0x00;
+          if (not getValue(rVal)) {
+            return false;
+          }
+          if (rVal == 0) {
+            printError("零除算が検出されました。", ErrorType::Input);
+            return false;
+          }
+          val /= rVal;
+        } else {
+          break;
+        }
+      }
+      return true;
+    }
+    // 加減算を読む。
+    [[nodiscard]] bool getAdd(uint8_t &val) {
+      if (not getMul(val)) {
+        return false;
+      }
+      for (;;) {
+        skipSpaceOrComment();
+        if (isCh('+')) {
+          uint8_t rVal = 0x00;
+          if (not getMul(rVal)) {
+            return false;
+          }
+          val += rVal;
+        } else if (isCh('-')) {
+          uint8_t rVal = 0x00;
+          if (not getMul(rVal)) {
+            return false;
+          }
+          val -= rVal;
+        } else {
+          break;
+        }
+      }
+      return true;
+    }
+    // 10進数の整数を読む。
+    [[nodiscard]] bool getDecimal(uint64_t &val) {
+      skipSpaceOrComment();
+      if (curLine.size() <= curIdx || not std::isdigit(curLine[curIdx])) {
+        printError("整数が必要です。", ErrorType::Input);
+        return false;
+      }
+      std::string numStr;
+      do {
+        numStr += curLine[curIdx++];
+      } while (curIdx < curLine.size() && std::isdigit(curLine[curIdx]));
+      try {
+        size_t lastIdx;
+        val = static_cast<uint64_t>(std::stoull(numStr, &lastIdx, 10));
+        if (lastIdx != numStr.size()) {
+          BUG("stoull");
+          return false;
+        }
+      } catch (const std::invalid_argument &e) {
+        BUG("stoull");
+        return false;
+      } catch (const std::out_of_range &e) {
+        printError(std::format("整数が大きすぎます。"
+                               "（整数: {}）",
+                               numStr),
+                   ErrorType::Input);
+        return false;
+      }
+      return true;
+    }
+    // コマンドやその引数の開始文字を判定する。
+    [[nodiscard]] bool isWordStart() {
+      return curIdx < curLine.size() &&
+             (std::isalpha(curLine[curIdx]) || curLine[curIdx] == '_');
+    }
+    // コマンドやその引数に使う文字を判定する。
+    [[nodiscard]] bool isWord() {
+      return curIdx < curLine.size() &&
+             (std::isalnum(curLine[curIdx]) || curLine[curIdx] == '-' ||
+              curLine[curIdx] == '_');
+    }
+    // '=' があるか調べる。
+    [[nodiscard]] bool checkEQ() {
+      skipSpaceOrComment();
+      if (not isCh('=')) {
+        printError("'=' が必要です。", ErrorType::Input);
+        return false;
+      }
+      return true;
+    }
+    // ']' があるか調べる。
+    [[nodiscard]] bool checkRSP() {
+      skipSpaceOrComment();
+      if (not isCh(']')) {
+        printError("']' が必要です。", ErrorType::Input);
+        return false;
+      }
+      return true;
+    }
+    // コマンドやその引数を取得する。
+    [[nodiscard]] bool getWord(std::string &word) {
+      skipSpaceOrComment();
+      if (not isWordStart()) {
+        return false;
+      }
+      do {
+        word += std::toupper(curLine[curIdx++]);
+      } while (isWord());
+      return true;
+    }
+    // ファイルのパスを読む（'"' で囲めば空白や ';' を含められる）。
+    [[nodiscard]] bool getPath(std::string &path) {
+      skipSpaceOrComment();
+      if (isCh('"')) {
+        while (curIdx < curLine.size() && curLine[curIdx] != '"') {
+          path += curLine[curIdx++];
+        }
+        if (not isCh('"')) {
+          printError("\" が必要です。", ErrorType::Input);
+          return false;
+        }
+      } else {
+        while (curIdx < curLine.size() && not std::isspace(curLine[curIdx]) &&
+               curLine[curIdx] != ';') {
+          path += curLine[curIdx++];
+        }
+      }
+      if (path.empty()) {
+        printError("ファイルのパスが必要です。", ErrorType::Input);
+        return false;
+      }
+      return true;
+    }
+    // 実数を読む
+    [[nodiscard]] bool getFloat(float &val) {
+      skipSpaceOrComment();
+      if (not isDigit()) {
+        printError("実数が必要です。", ErrorType::Input);
+        return false;
+      }
+      std::string numStr;
+      do {
+        numStr += curLine[curIdx++];
+      } while (isDigit());
+      if (isCh('.')) {
+        if (not isDigit()) {
+          printError("'.' の後に小数部がありません。", ErrorType::Input);
+          return false;
+        }
+        numStr += '.';
+        do {
+          numStr += curLine[curIdx++];
+        } while (isDigit());
+      }
+      try {
+        size_t lastIdx;
+        val = std::stof(numStr, &lastIdx);
+        if (lastIdx != numStr.size()) {
+          BUG("stoi");
+          return false;
+        }
+      } catch (const std::invalid_argument &e) {
+        BUG("stoi");
+        return false;
+      } catch (const std::out_of_range &e) {
+        printError(std::format("実数が大きすぎます。 （実数: \"{}\"）", numStr),
+                   ErrorType::Input);
+        return false;
+      }
+      return true;
+    }
+    // 一行読む
+    [[nodiscard]] bool readLine(EventList &eventList) {
+      if (isCh('$')) { // コマンド行
+        std::string cmd;
+        if (not getWord(cmd)) {
+          printError("コマンドが必要です。", ErrorType::Input);
+          return true;
+        }
+        if (cmd == "RUN") {
+          eventList.emplace_back(std::make_unique<Event>(EventType::Run));
+        } else if (cmd == "STOP") {
+          eventList.emplace_back(std::make_unique<Event>(EventType::Stop));
+        } else if (cmd == "RESET") {
+          eventList.emplace_back(std::make_unique<Event>(EventType::Reset));
+        } else if (cmd == "WAIT") {
+          std::string arg;
+          if (not getWord(arg)) {
+            printError("引数が必要です。", ErrorType::Input);
+            return true;
+          }
+          if (arg == "STOP") {
+            eventList.emplace_back(
+                std::make_unique<Event>(EventType::WaitStop));
+          } else if (arg == "STATES" || arg == "MS" || arg == "SEC") {
+            uint64_t states = 0;
+            if (not getDecimal(states)) {
+              return true;
+            }
+            if (arg == "MS") {
+              states = states * TeC::StatesPerSec / 1000;
+            } else if (arg == "SEC") {
+              states = states * TeC::StatesPerSec;
+            }
+            eventList.emplace_back(std::make_unique<WaitStatesEvent>(states));
+          } else if (arg == "SERIAL") {
+            eventList.emplace_back(
+                std::make_unique<Event>(EventType::WaitSerial));
+          } else {
+            printError(std::format("WAITコマンドの対象が不正です。"
+                                   "（対象: {}）",
+                                   arg),
+                       ErrorType::Input);
+            return true;
+          }
+        } else if (cmd == "LIMIT") {
+          std::string arg;
+          if (not getWord(arg)) {
+            printError("引数が必要です。", ErrorType::Input);
+            return true;
+          }
+          if (arg == "STATES") {
+            uint64_t states = 0;
+            if (not getDecimal(states)) {
+              return true;
+            }
+            eventList.emplace_back(std::make_unique<LimitStatesEvent>(states));
+          } else {
+            printError(std::format("LIMITコマンドの対象が不正です。"
+                                   "（対象: {}）",
+                                   arg),
+                       ErrorType::Input);
+            return true;
+          }
+        } else if (cmd == "DATA-SW") {
+          uint8_t val = 0x00;
+          if (not getAdd(val)) {
+            return true;
+          }
+          eventList.emplace_back(std::make_unique<SetDataSWEvent>(val));
+        } else if (cmd == "SERIAL-MODE" || cmd == "PRINT-MODE") {
+          std::string mode;
+          if (not getWord(mode)) {
+            printError("引数が必要です。", ErrorType::Input);
+            return true;
+          }
+          if (const std::optional<OutputMode> m = StrToOutputMode(mode)) {
+            if (cmd == "SERIAL-MODE") {
+              eventList.emplace_back(
+                  std::make_unique<SetSerialModeEvent>(m.value()));
+            } else {
+              eventList.emplace_back(
+                  std::make_unique<SetPrintModeEvent>(m.value()));
+            }
+          } else {
+            printError("出力モードが必要です。"
+                       "（使用可能な出力モード: (RAW|HEX|TEC|SDEC|UDEC)）",
+                       ErrorType::Input);
+            return true;
+          }
+        } else if (cmd == "PRINT") {
+          skipSpaceOrComment();
+          if (isCh('[')) {
+            uint8_t addr = 0x00;
+            if (not getAdd(addr)) {
+              return true;
+            }
+            if (not checkRSP()) {
+              return true;
+            }
+            eventList.emplace_back(std::make_unique<PrintMMEvent>(addr));
+          } else if (curIdx < curLine.size() && std::isalpha(curLine[curIdx])) {
+            std::string regOrFlg;
+            do {
+              regOrFlg += std::toupper(curLine[curIdx++]);
+            } while (curIdx < curLine.size() &&
+                     (std::isalnum(curLine[curIdx]) || curLine[curIdx] == '-'));
+            if (const std::optional<Reg> reg = StrToReg(regOrFlg)) {
+              eventList.emplace_back(
+                  std::make_unique<PrintRegEvent>(reg.value()));
+            } else if (const std::optional<Flg> flg = StrToFlg(regOrFlg)) {
+              eventList.emplace_back(
+                  std::make_unique<PrintFlgEvent>(flg.value()));
+            } else if (regOrFlg == "PARALLEL") {
+              eventList.emplace_back(
+                  std::make_unique<Event>(EventType::PrintParallel));
+            } else if (regOrFlg == "EXT-PARALLEL") {
+              eventList.emplace_back(
+                  std::make_unique<Event>(EventType::PrintExtParallel));
+            } else if (regOrFlg == "BUZ") {
+              eventList.emplace_back(
+                  std::make_unique<Event>(EventType::PrintBuz));
+            } else if (regOrFlg == "SPK") {
+              eventList.emplace_back(
+                  std::make_unique<Event>(EventType::PrintSpk));
+            } else if (regOrFlg == "RUN") {
+              eventList.emplace_back(
+                  std::make_unique<Event>(EventType::PrintRun));
+            } else {
+              printError(std::format("レジスタまたはフラグ名が不正です。 "
+                                     "(名前の開始部: \"{}\")",
+                                     regOrFlg),
+                         ErrorType::Input);
+              return true;
+            }
+          } else {
+            printError("表示対象が不正です。", ErrorType::Input);
+            return true;
+          }
+        } else if (cmd == "SERIAL") {
+          std::vector<uint8_t> data;
+          do {
+            skipSpaceOrComment();
+            if (isCh('"')) {
+              while (curIdx < curLine.size() && std::isprint(curLine[curIdx]) &&
+                     curLine[curIdx] != '"') {
+                data.emplace_back(static_cast<uint8_t>(curLine[curIdx++]));
+              }
+              if (not isCh('"')) {
+                printError("\" が必要です。", ErrorType::Input);
+                return true;
+              }
+            } else {
+              if (not getAdd(data.emplace_back())) {
+                return true;
+              }
+            }
+          } while (isCh(','));
+          eventList.emplace_back(
+              std::make_unique<SerialEvent>(std::move(data)));
+        } else if (cmd == "SERIAL-FILE") {
+          std::string path;
+          if (not getPath(path)) {
+            return true;
+          }
+          eventList.emplace_back(
+              std::make_unique<SerialFileEvent>(std::move(path)));
+        } else if (cmd == "SAVE" || cmd == "LOAD") {
+          std::string path;
+          if (not getPath(path)) {
+            return true;
+          }
+          eventList.emplace_back(std::make_unique<SnapshotEvent>(
+              cmd == "SAVE" ? EventType::Save : EventType::Load,
+              std::move(path)));
+        } else if (cmd == "WRITE") {
+          eventList.emplace_back(std::make_unique<Event>(EventType::Write));
+        } else if (cmd == "ANALOG") {
+          std::string chStr;
+          if (not getWord(chStr)) {
+            printError("ADCチャンネルが必要です。", ErrorType::Input);
+            return true;
+          }
+          if (chStr.size() != 3 || chStr[0] != 'C' || chStr[1] != 'H' ||
+              chStr[2] < '0' || '3' < chStr[2]) {
+            printError("ADCチャンネルが必要です。", ErrorType::Input);
+            return true;
+          }
+          const uint8_t ch = static_cast<uint8_t>(chStr[2] - '0');
+          float fVal = 0.0;
+          if (not getFloat(fVal)) {
+            return true;
+          }
+          skipSpaceOrComment();
+          uint8_t val = 0;
+          if (isCh('V')) {
+            val = static_cast<uint8_t>(
+                std::min(255U, static_cast<unsigned int>(255 * fVal / 3.3F)));
+          } else if (isCh('m') && isCh('V')) {
+            val = static_cast<uint8_t>(std::min(
+                255U, static_cast<unsigned int>(255 * fVal / 3300.0F)));
+          } else {
+            printError("'V' または \"mV\" が必要です。", ErrorType::Input);
+            return true;
+          }
+          eventList.emplace_back(std::make_unique<AnalogEvent>(ch, val));
+        } else if (cmd == "PARALLEL") {
+          uint8_t val = 0;
+          if (not getAdd(val)) {
+            return true;
+          }
+          eventList.emplace_back(std::make_unique<ParallelWriteEvent>(val));
+        } else if (cmd == "END") {
+          return false;
+        } else {
+          printError(
+              std::format("不正なコマンドです。（コマンド名: \"{}\"）", cmd),
+              ErrorType::Input);
+          return true;
+        }
+      } else if (isCh('[')) { // 主記憶の値の変更
+        uint8_t addr;
+        if (not getAdd(addr)) {
+          return true;
+        }
+        // ']'
+        if (not checkRSP()) {
+          return true;
+        }
+        // '='
+        if (not checkEQ()) {
+          return true;
+        }
+        uint8_t val = 0x00;
+        if (not getAdd(val)) {
+          return true;
+        }
+        eventList.emplace_back(std::make_unique<SetMMEvent>(addr, val));
+      } else if (curIdx < curLine.size() && std::isalpha(curLine[curIdx])) {
+        // レジスタかフラグ
+        std::string cmd;
+        do {
+          cmd += std::toupper(curLine[curIdx++]);
+        } while (curIdx < curLine.size() && std::isalnum(curLine[curIdx]));
+        if (const std::optional<Reg> reg = StrToReg(cmd)) {
+          if (not checkEQ()) {
+            return true;
+          }
+          uint8_t val = 0x00;
+          if (not getAdd(val)) {
+            return true;
+          }
+          eventList.emplace_back(
+              std::make_unique<SetRegEvent>(reg.value(), val));
+        } else if (const std::optional<Flg> flg = StrToFlg(cmd)) {
+          if (not checkEQ()) {
+            return true;
+          }
+          skipSpaceOrComment();
+          bool v = false;
+          if (curIdx < curLine.size()) {
+            if (curLine[curIdx] == '0') {
+              ++curIdx;
+              v = false;
+            } else if (curLine[curIdx] == '1') {
+              ++curIdx;
+              v = true;
+            } else {
+              printError("'0' または '1' が必要です。", ErrorType::Input);
+              return true;
+            }
+          }
+          eventList.emplace_back(std::make_unique<SetFlgEvent>(flg.value(), v));
+        } else {
+          printError(
+              std::format(
+                  "レジスタまたはフラグ名が不正です。（名前の開始部: \"{}\"）",
+                  cmd),
+              ErrorType::Input);
+          return true;
+        }
+      }
+      skipSpaceOrComment();
+      if (curIdx < curLine.size()) {
+        printError(std::format("入力の後部が解析できませんでした。（行: {}）",
+                               curLine),
+                   ErrorType::Input);
+        return true;
+      }
+      return true;
+    }
+
+    std::optional<EventList> operator()() {
+      EventList eventList;
+      while (std::getline(in, curLine)) {
+        curIdx = 0;
+        if (not readLine(eventList)) {
+          break;
+        }
+      }
+      // 入力時点でエラーが発生すれば実行しない
+      if (hasError) {
+        return std::nullopt;
+      }
+      // プログラム終了まで実行するため
+      eventList.emplace_back(std::make_unique<Event>(EventType::WaitStop));
+      return eventList;
+    }
+  };
+  return InputReader{.in = in, .err = err, .nameTable = nameTable}();
+}
+
+/// @brief 名前表を読む。
+/// @param path ファイルのパス
+/// @param err エラーメッセージの出力先
+/// @return 名前表（エラーがあれば全て出力して std::nullopt）
+static inline std::optional<NameTable> ReadNameTable(const char *path,
+                                                     std::ostream &err) {
+  std::ifstream ifs{path};
+  if (not ifs) {
+    WriteError(err,
+               std::format("ファイルが開けませんでした。"
+                           "（ファイルのパス: \"{}\"）",
+                           path),
+               ErrorType::NameTable);
+    return std::nullopt;
+  }
+  NameTable table;
+  std::string line;
+  size_t lineNum = 0;
+  bool hasError = false;
+  while (std::getline(ifs, line)) {
+    size_t idx = 0;
+    ++lineNum;
+    // 空白を読み飛ばす。
+    auto skipSpace = [&]() -> void {
+      while (idx < line.size() && std::isspace(line[idx])) {
+        ++idx;
+      }
+    };
+    // ラベルの先頭文字判定
+    auto isLabelStart = [&]() -> bool {
+      return idx < line.size() && (std::isalpha(line[idx]) || line[idx] == '_');
+    };
+    // ラベル文字判定
+    auto isLabel = [&]() -> bool {
+      return idx < line.size() && (std::isalnum(line[idx]) || line[idx] == '_');
+    };
+    // 名前表のエラーを出力する（続けて読み取り、全てのエラーを出力する）。
+    auto printNameTableError = [&](const std::string &msg) -> void {
+      WriteError(err, std::format("{}:{}: {}", path, lineNum, msg),
+                 ErrorType::NameTable);
+      hasError = true;
+    };
+    skipSpace();
+    if (idx < line.size()) {
+      if (not isLabelStart()) {
+        printNameTableError("ラベルが必要です。");
+        continue;
+      }
+      std::string label;
+      do {
+        label += std::toupper(line[idx++]);
+      } while (isLabel());
+      skipSpace();
+      if (line.size() <= idx || line[idx] != ':') {
+        printNameTableError("':' が必要です。");
+        continue;
+      }
+      ++idx;
+      skipSpace();
+      if (line.size() <= idx || not std::isdigit(line[idx])) {
+        printNameTableError("値が必要です。");
+        continue;
+      }
+      std::string numStr;
+      bool hex = false;
+      do {
+        if (not std::isdigit(line[idx])) {
+          hex = true;
+        }
+        numStr += line[idx++];
+      } while (idx < line.size() && std::isxdigit(line[idx]));
+      if (idx < line.size() && std::toupper(line[idx]) == 'H') {
+        hex = true;
+        ++idx;
+      } else if (hex) {
+        printNameTableError("'H' が必要です。");
+        continue;
+      }
+      try {
+        size_t lastIdx;
+        uint8_t addr =
+            static_cast<uint8_t>(std::stoi(numStr, &lastIdx, hex ? 16 : 10));
+        if (lastIdx != numStr.size()) {
+          BUG("stoi");
+        }
+        table.emplace(label, addr);
+      } catch (const std::invalid_argument &e) {
+        BUG("stoi");
+      } catch (const std::out_of_range &e) {
+        printNameTableError(
+            std::format("値が大きすぎます。 （値: {}）", numStr));
+        continue;
+      }
+      skipSpace();
+      if (idx < line.size()) {
+        printNameTableError(
+            std::format("名前表の形式が不正です。（行: \"{}\"）", line));
+        continue;
+      }
+    }
+  }
+  if (hasError) {
+    return std::nullopt;
+  }
+  return table;
+}
+
+/// @brief 名前表を読む（エラーがあれば出力して終了する）。
+/// @param path ファイルのパス
+/// @return 名前表
+static inline NameTable ReadNameTable(const char *path) {
+  std::optional<NameTable> table = ReadNameTable(path, std::cerr);
+  if (not table) {
+    std::exit(1);
+  }
+  return std::move(table.value());
+}
+
+/// @brief 入力されたバイナリ
+struct Source {
+  /// @brief 開始アドレス
+  uint8_t start;
+  /// @brief サイズ
+  uint8_t size;
+  /// @brief 値
+  std::array<uint8_t, 256> values;
+};
+
+/// @brief 機械語を読む。
+/// @param path ファイルのパス
+/// @param err エラーメッセージの出力先
+/// @return 機械語（エラーがあれば出力して std::nullopt）
+static inline std::optional<Source> readSource(const char *path,
+                                               std::ostream &err) {
+  std::ifstream ifs{path, std::ios_base::in | std::ios_base::binary};
+  if (not ifs) {
+    WriteError(
+        err,
+        std::format("ファイルが開けませんでした （ファイルのパス: \"{}\"）",
+                    path),
+        ErrorType::Binary);
+    return std::nullopt;
+  }
+  Source source;
+  source.start = static_cast<uint8_t>(ifs.get());
+  bool valid = not ifs.eof();
+  source.size = static_cast<uint8_t>(ifs.get());
+  valid = valid && not ifs.eof();
+  if (valid) {
+    ifs.read(reinterpret_cast<char *>(source.values.data()),
+             sizeof(source.values));
+    valid = ifs.gcount() == source.size;
+  }
+  if (valid) {
+    ifs.get();
+    valid = ifs.eof();
+  }
+  if (not valid) {
+    WriteError(err, "機械語ファイルの形式が不正です。", ErrorType::Binary);
+    return std::nullopt;
+  }
+  return source;
+}
+
+/// @brief 機械語を読む（エラーがあれば出力して終了する）。
+/// @param path ファイルのパス
+/// @return 機械語
+static inline Source readSource(const char *path) {
+  const std::optional<Source> source = readSource(path, std::cerr);
+  if (not source) {
+    std::exit(1);
+  }
+  return source.value();
+}
+
+/// @brief 使用方法を出力して終了する。
+/// @param cmd 自分自身の名前
+[[noreturn]] static void Usage(const char *cmd) {
+  std::cerr << std::format(
+      "使用方法: {} [--engine=(interp|threaded|block|jit|tiered)] "
+      "[--max-states=<ステート数>] [--timeout-ms=<ミリ秒数>] [--stats] "
+      "<program>.bin [<program>.nt] "
+      "[[--jobs=<並列数>] [--combined] --cases (<case>.in|<dir>) ...]\n"
+      "       {} [<オプション>] --serve <ソケットのパス>\n",
+      cmd, cmd);
+  std::exit(1);
+}
+
+/// @brief TeCのシリアル入力 FIFO へ書き込む入力の列
+/// @note ファイルは少しずつ読み込むので、大きなファイルでも使用するメモリは一定。
+class SerialInput {
+public:
+  SerialInput()
+      : m_srcs(), m_pos(0), m_chunk(), m_chunkSize(0), m_restored() {}
+
+  /// @brief 書き込む入力が残っていないか
+  bool empty() const noexcept { return m_srcs.empty(); }
+
+  /// @brief バイト列を入力の末尾に追加する。
+  /// @param bytes バイト列（入力が全て書き込まれるまで有効であること）
+  void push(const std::vector<uint8_t> &bytes) {
+    if (not bytes.empty()) {
+      m_srcs.push_back(
+          {.bytes = &bytes, .file = nullptr, .path = {}, .offset = 0});
+    }
+  }
+
+  /// @brief ファイルの内容を入力の末尾に追加する。
+  /// @param path ファイルのパス
+  /// @param offset 書き込みを始める位置
+  /// @return ファイルが開けなければ false
+  [[nodiscard]] bool pushFile(const std::string &path,
+                              const uint64_t offset = 0) {
+    auto file = std::make_unique<std::ifstream>(path, std::ios_base::binary);
+    if (offset != 0) {
+      file->seekg(static_cast<std::streamoff>(offset));
+    }
+    if (not *file) {
+      return false;
+    }
+    if (file->peek() != std::ifstream::traits_type::eof()) {
+      m_srcs.push_back(
+          {.bytes = nullptr, .file = std::move(file), .path = path,
+           .offset = offset});
+    }
+    return true;
+  }
+
+  /// @brief TeCのシリアル入力 FIFO に入るだけ書き込む。
+  /// @param tec TeC
+  void feed(TeC &tec) {
+    while (not m_srcs.empty()) {
+      Src &src = m_srcs.front();
+      if (src.file != nullptr) {
+        if (m_pos == m_chunkSize) {
+          src.file->read(reinterpret_cast<char *>(m_chunk.data()),
+                         static_cast<std::streamsize>(m_chunk.size()));
+          m_chunkSize = static_cast<size_t>(src.file->gcount());
+          src.offset += m_chunkSize;
+          m_pos = 0;
+        }
+        m_pos += tec.writeSerialIn(&m_chunk[m_pos], m_chunkSize - m_pos);
+        if (m_pos < m_chunkSize) {
+          return;
+        }
+        // ファイルの終わりまで書き込んだら次の入力へ
+        if (src.file->peek() != std::ifstream::traits_type::eof()) {
+          continue;
+        }
+        m_chunkSize = 0;
+      } else {
+        m_pos += tec.writeSerialIn(&(*src.bytes)[m_pos],
+                                   src.bytes->size() - m_pos);
+        if (m_pos < src.bytes->size()) {
+          return;
+        }
+      }
+      m_pos = 0;
+      m_srcs.pop_front();
+    }
+  }
+
+  /// @brief 書き込んでいない入力を取得する（入力は消費しない）。
+  /// @return 書き込んでいない入力のバイト列
+  /// @note ファイルの残りも読み込むので、ファイルに保存する場合に使う
+  /// （メモリ上で続きを実行するだけなら state() を使う）。
+  std::vector<uint8_t> pending() {
+    std::vector<uint8_t> bytes;
+    for (size_t i = 0; i < m_srcs.size(); ++i) {
+      Src &src = m_srcs[i];
+      // 先頭の入力は m_pos 以降が残っている
+      const size_t pos = i == 0 ? m_pos : 0;
+      if (src.file != nullptr) {
+        if (i == 0) {
+          bytes.insert(bytes.end(), m_chunk.begin() + pos,
+                       m_chunk.begin() + m_chunkSize);
+        }
+        const std::istream::pos_type mark = src.file->tellg();
+        bytes.insert(bytes.end(), std::istreambuf_iterator<char>(*src.file),
+                     std::istreambuf_iterator<char>());
+        src.file->clear();
+        src.file->seekg(mark);
+      } else {
+        bytes.insert(bytes.end(), src.bytes->begin() + pos, src.bytes->end());
+      }
+    }
+    return bytes;
+  }
+
+  /// @brief 入力をバイト列に置き換える。
+  /// @param bytes 書き込む入力のバイト列（pending() を参照）
+  void restore(std::vector<uint8_t> &&bytes) {
+    clear();
+    push(m_restored.emplace_back(std::move(bytes)));
+  }
+
+  /// @brief 書き込んでいない入力（state() を参照）
+  struct State {
+    /// @brief 入力（バイト列かファイルのどちらか）
+    struct Src {
+      /// @brief 書き込んでいないバイト列（ファイルの場合は空）
+      std::vector<uint8_t> bytes;
+      /// @brief ファイルのパス（バイト列の場合は空）
+      std::string path;
+      /// @brief ファイルの書き込んでいない部分の位置
+      uint64_t offset;
+    };
+    /// @brief 書き込む入力の列
+    std::vector<Src> srcs;
+  };
+
+  /// @brief 書き込んでいない入力を取得する（入力は消費しない）。
+  /// @return 書き込んでいない入力
+  /// @note ファイルは内容を読み込まずに、パスと位置で表す。
+  State state() const {
+    State state{};
+    for (size_t i = 0; i < m_srcs.size(); ++i) {
+      const Src &src = m_srcs[i];
+      // 先頭の入力は m_pos 以降が残っている
+      const size_t pos = i == 0 ? m_pos : 0;
+      if (src.file != nullptr) {
+        // 読み込んだ部分の書き込んでいない分だけ戻った位置
+        const uint64_t unread = i == 0 ? m_chunkSize - pos : 0;
+        state.srcs.push_back(
+            {.bytes = {}, .path = src.path, .offset = src.offset - unread});
+      } else {
+        state.srcs.push_back(
+            {.bytes = {src.bytes->begin() + pos, src.bytes->end()},
+             .path = {},
+             .offset = 0});
+      }
+    }
+    return state;
+  }
+
+  /// @brief 入力を置き換える。
+  /// @param state 書き込む入力（state() を参照）
+  /// @param path 開けなかったファイルのパスの格納先
+  /// @return ファイルが開けなければ false
+  [[nodiscard]] bool restore(State &&state, std::string &path) {
+    clear();
+    for (State::Src &src : state.srcs) {
+      if (src.path.empty()) {
+        push(m_restored.emplace_back(std::move(src.bytes)));
+      } else if (not pushFile(src.path, src.offset)) {
+        path = std::move(src.path);
+        return false;
+      }
+    }
+    return true;
+  }
+
+private:
+  /// @brief 入力（バイト列かファイルのどちらか）
+  struct Src {
+    const std::vector<uint8_t> *bytes;
+    std::unique_ptr<std::ifstream> file;
+    /// @brief ファイルのパス
+    std::string path;
+    /// @brief ファイルから m_chunk に読み込んだ部分の終わりの位置
+    uint64_t offset;
+  };
+  /// @brief 書き込む入力の列
+  std::deque<Src> m_srcs;
+  /// @brief 先頭の入力（ファイルの場合は m_chunk）の書き込み済みの位置
+  size_t m_pos;
+  /// @brief ファイルから読み込んだ部分
+  std::array<uint8_t, TeC::SerialFifoSize> m_chunk;
+  /// @brief ファイルから読み込んだバイト数
+  size_t m_chunkSize;
+  /// @brief restore() で置き換えた入力のバイト列
+  std::deque<std::vector<uint8_t>> m_restored;
+
+  /// @brief 入力を空にする。
+  void clear() noexcept {
+    m_srcs.clear();
+    m_pos = 0;
+    m_chunkSize = 0;
+    m_restored.clear();
+  }
+};
+
+/// @brief TeCのシリアル出力とその他の入出力の表示用
+class Printer {
+public:
+  /// @brief バッファにある出力の種類
+  enum class Src : uint8_t { None, Serial, Print };
+
+  /// @brief 表示モードと表示待ちの出力（state() を参照）
+  struct State {
+    SerialMode serialMode;
+    PrintMode printMode;
+    std::vector<uint8_t> buffer;
+    Src curSrc;
+  };
+
+  /// @param out 出力先
+  explicit Printer(std::ostream &out)
+      : m_out(out), m_serialMode(DefaultSerialMode),
+        m_printMode(DefaultPrintMode), m_buffer(), m_curSrc(Src::None) {}
+
+  void setSerialMode(const SerialMode mode) {
+    if (m_curSrc == Src::Serial) {
+      flush(m_serialMode);
+    }
+    m_serialMode = mode;
+  }
+
+  void setPrintMode(const PrintMode mode) {
+    if (m_curSrc == Src::Print) {
+      flush(m_printMode);
+    }
+    m_printMode = mode;
+  }
+
+  SerialMode serialMode() const noexcept { return m_serialMode; }
+
+  PrintMode printMode() const noexcept { return m_printMode; }
+
+  /// @brief 表示モードと表示待ちの出力を取得する。
+  /// @return 状態
+  State state() const {
+    return State{.serialMode = m_serialMode,
+                 .printMode = m_printMode,
+                 .buffer = m_buffer,
+                 .curSrc = m_curSrc};
+  }
+
+  /// @brief 表示モードと表示待ちの出力を置き換える（出力先は変えない）。
+  /// @param state 状態（state() を参照）
+  void restore(State &&state) {
+    m_serialMode = state.serialMode;
+    m_printMode = state.printMode;
+    m_buffer = std::move(state.buffer);
+    m_curSrc = state.curSrc;
+  }
+
+  void serial(const uint8_t b) {
+    if (m_curSrc != Src::Serial) {
+      flush();
+      m_curSrc = Src::Serial;
+    }
+    m_buffer.emplace_back(b);
+  }
+
+  void print(const uint8_t b) {
+    if (m_curSrc != Src::Print) {
+      flush();
+      m_curSrc = Src::Print;
+    }
+    m_buffer.emplace_back(b);
+  }
+
+  void flush() {
+    switch (m_curSrc) {
+    case Src::None:
+      assert(m_buffer.empty());
+      break;
+    case Src::Serial:
+      flush(m_serialMode);
+      break;
+    case Src::Print:
+      flush(m_printMode);
+      break;
+    default:
+      BUG("Printer::flush");
+      break;
+    }
+  }
+
+private:
+  std::ostream &m_out;
+
+  SerialMode m_serialMode;
+
+  PrintMode m_printMode;
+
+  std::vector<uint8_t> m_buffer;
+
+  Src m_curSrc;
+
+  void flush(const OutputMode mode) {
+    switch (mode) {
+    case SerialMode::Raw:
+      for (const uint8_t ch : m_buffer) {
+        m_out << static_cast<char>(ch);
+      }
+      break;
+    case SerialMode::Hex:
+      for (size_t idx = 0; idx < m_buffer.size(); ++idx) {
+        m_out << std::format("{:0>2X}",
+                                 static_cast<unsigned int>(m_buffer[idx]));
+        if (idx + 1 < m_buffer.size()) {
+          m_out << (((idx + 1) & 7) == 0 ? '\n' : ' ');
+        }
+      }
+      m_out << '\n';
+      break;
+    case SerialMode::TeC:
+      for (const uint8_t ch : m_buffer) {
+        m_out << std::format("{:0>3X}H\n", static_cast<unsigned int>(ch));
+      }
+      break;
+    case SerialMode::SDEC:
+      for (const uint8_t ch : m_buffer) {
+        m_out << std::format(
+            "{}\n", static_cast<signed int>(static_cast<int8_t>(ch)));
+      }
+      break;
+    case SerialMode::UDEC:
+      for (const uint8_t ch : m_buffer) {
+        m_out << std::format("{}\n", static_cast<unsigned int>(ch & 0xFF));
+      }
+      break;
+    default:
+      BUG("Printer::flush");
+      break;
+    }
+    m_buffer.clear();
+  }
+};
+
+/// @brief ケースの実行状態のスナップショット（$SAVE, $LOAD）
+struct CaseSnapshot {
+  /// @brief TeC の状態
+  TeCSnapshot tec;
+  /// @brief シリアル出力モード
+  SerialMode serialMode;
+  /// @brief 表示モード
+  PrintMode printMode;
+  /// @brief TeC に書き込んでいないシリアル入力
+  std::vector<uint8_t> serialIn;
+};
+
+/// @brief スナップショットのファイルの先頭に置く識別子
+static constexpr std::string_view SnapshotMagic{"TECSNAP", 8};
+
+/// @brief スナップショットのファイル形式の版
+/// （形式を変えたら増やし、古い版のファイルは読まない）
+static constexpr uint8_t SnapshotVersion = 1;
+
+/// @brief スナップショットを書き込む。
+/// @param out 出力先（バイナリモード）
+/// @param snap スナップショット
+/// @note
+/// 形式は SnapshotMagic, SnapshotVersion に続けて各状態を決まった順に並べた
+/// もの（複数バイトの値はリトルエンディアン、フラグはビットにまとめる）。
+static inline void WriteSnapshot(std::ostream &out, const CaseSnapshot &snap) {
+  auto put8 = [&](const uint8_t val) -> void {
+    out.put(static_cast<char>(val));
+  };
+  auto putN = [&](const uint64_t val, const size_t bytes) -> void {
+    for (size_t i = 0; i < bytes; ++i) {
+      put8(static_cast<uint8_t>(val >> (8 * i)));
+    }
+  };
+  auto putBytes = [&](const uint8_t *data, const size_t size) -> void {
+    out.write(reinterpret_cast<const char *>(data),
+              static_cast<std::streamsize>(size));
+  };
+  const TeCState &tec = snap.tec.state;
+  out.write(SnapshotMagic.data(),
+            static_cast<std::streamsize>(SnapshotMagic.size()));
+  put8(SnapshotVersion);
+  for (const uint8_t reg : {tec.g0, tec.g1, tec.g2, tec.sp, tec.pc}) {
+    put8(reg);
+  }
+  put8(static_cast<uint8_t>(tec.flgC() << 0 | tec.flgS() << 1 |
+                            tec.flgZ() << 2 | tec.intEna << 3 | tec.run << 4 |
+                            tec.err << 5));
+  putBytes(tec.mm.data(), tec.mm.size());
+  for (const uint8_t reg :
+       {tec.dataSW, tec.rxReg, tec.txReg, tec.tmrCnt, tec.tmrPeriod,
+        tec.parallelIn, tec.parallelOut,
+        static_cast<uint8_t>(tec.extParallelOut)}) {
+    put8(reg);
+  }
+  putBytes(tec.adcChs.data(), tec.adcChs.size());
+  put8(static_cast<uint8_t>(tec.buz << 0 | tec.spk << 1 | tec.tmrEna << 2 |
+                            tec.extParallelOutEna << 3 | tec.tmrElapsed << 4 |
+                            tec.serialPending << 5));
+  put8(tec.intReq);
+  put8(tec.intMask);
+  putN(tec.tmrClkCnt, 2);
+  putN(tec.totalStates, 8);
+  putN(snap.tec.serialIn.size(), 2);
+  putBytes(snap.tec.serialIn.data(), snap.tec.serialIn.size());
+  putN(snap.tec.serialOut.size(), 2);
+  putBytes(snap.tec.serialOut.data(), snap.tec.serialOut.size());
+  put8(static_cast<uint8_t>(snap.serialMode));
+  put8(static_cast<uint8_t>(snap.printMode));
+  putN(snap.serialIn.size(), 8);
+  putBytes(snap.serialIn.data(), snap.serialIn.size());
+}
+
+/// @brief スナップショットを読み込む。
+/// @param in 入力（バイナリモード）
+/// @return スナップショット（形式が不正なら std::nullopt）
+static inline std::optional<CaseSnapshot> ReadSnapshot(std::istream &in) {
+  bool ok = true;
+  auto get8 = [&]() -> uint8_t {
+    const std::istream::int_type ch = in.get();
+    if (ch == std::istream::traits_type::eof()) {
+      ok = false;
+      return 0;
+    }
+    return static_cast<uint8_t>(ch);
+  };
+  auto getN = [&](const size_t bytes) -> uint64_t {
+    uint64_t val = 0;
+    for (size_t i = 0; i < bytes; ++i) {
+      val |= static_cast<uint64_t>(get8()) << (8 * i);
+    }
+    return val;
+  };
+  auto getBytes = [&](uint8_t *data, const size_t size) -> void {
+    in.read(reinterpret_cast<char *>(data), static_cast<std::streamsize>(size));
+    ok = ok && static_cast<size_t>(in.gcount()) == size;
+  };
+  // 長さに続くバイト列（長さが上限を超えれば不正）
+  auto getVector = [&](std::vector<uint8_t> &data, const size_t lengthBytes,
+                       const uint64_t maxSize) -> void {
+    const uint64_t size = getN(lengthBytes);
+    if (not ok || maxSize < size) {
+      ok = false;
+      return;
+    }
+    // 長さが壊れていても読めた分しか確保しない
+    while (ok && data.size() < size) {
+      const size_t pos = data.size();
+      data.resize(pos + std::min<uint64_t>(size - pos, 1 << 16));
+      getBytes(&data[pos], data.size() - pos);
+    }
+  };
+  std::array<char, SnapshotMagic.size()> magic{};
+  in.read(magic.data(), static_cast<std::streamsize>(magic.size()));
+  if (not in || std::string_view{magic.data(), magic.size()} != SnapshotMagic ||
+      get8() != SnapshotVersion) {
+    return std::nullopt;
+  }
+  CaseSnapshot snap{};
+  TeCState &tec = snap.tec.state;
+  for (uint8_t *reg : {&tec.g0, &tec.g1, &tec.g2, &tec.sp, &tec.pc}) {
+    *reg = get8();
+  }
+  const uint8_t flgs = get8();
+  tec.setFlgs((flgs & 0x01) != 0, (flgs & 0x02) != 0, (flgs & 0x04) != 0);
+  tec.intEna = (flgs & 0x08) != 0;
+  tec.run = (flgs & 0x10) != 0;
+  tec.err = (flgs & 0x20) != 0;
+  getBytes(tec.mm.data(), tec.mm.size());
+  for (uint8_t *reg :
+       {&tec.dataSW, &tec.rxReg, &tec.txReg, &tec.tmrCnt, &tec.tmrPeriod,
+        &tec.parallelIn, &tec.parallelOut}) {
+    *reg = get8();
+  }
+  tec.extParallelOut = get8() & 0x0F;
+  getBytes(tec.adcChs.data(), tec.adcChs.size());
+  const uint8_t devs = get8();
+  tec.buz = (devs & 0x01) != 0;
+  tec.spk = (devs & 0x02) != 0;
+  tec.tmrEna = (devs & 0x04) != 0;
+  tec.extParallelOutEna = (devs & 0x08) != 0;
+  tec.tmrElapsed = (devs & 0x10) != 0;
+  tec.serialPending = (devs & 0x20) != 0;
+  tec.intReq = get8();
+  tec.intMask = get8();
+  tec.tmrClkCnt = static_cast<uint16_t>(getN(2));
+  tec.totalStates = getN(8);
+  getVector(snap.tec.serialIn, 2, TeC::SerialFifoSize);
+  getVector(snap.tec.serialOut, 2, TeC::SerialFifoSize);
+  const uint8_t serialMode = get8();
+  const uint8_t printMode = get8();
+  if (static_cast<uint8_t>(OutputMode::UDEC) < serialMode ||
+      static_cast<uint8_t>(OutputMode::UDEC) < printMode) {
+    return std::nullopt;
+  }
+  snap.serialMode = static_cast<SerialMode>(serialMode);
+  snap.printMode = static_cast<PrintMode>(printMode);
+  getVector(snap.serialIn, 8, UINT64_MAX);
+  // 後ろに余分なデータがあれば不正
+  if (not ok || in.peek() != std::istream::traits_type::eof()) {
+    return std::nullopt;
+  }
+  return snap;
+}
+
+/// @brief TeCのスタックトレースを求める。
+/// @param tec TeC
+/// @return エラーメッセージ
+static inline std::string StackTrace(const TeC &tec) {
+  std::string msg;
+  msg.reserve(1024);
+  msg += "INVALID INSTRUCTION.\n";
+  const uint8_t pc = tec.getReg(Reg::PC);
+  const uint8_t sp = tec.getReg(Reg::SP);
+  // PC
+  msg += std::format("PC: {:0>3X}H\n", pc);
+  // [PC - 4], [PC - 3], [PC - 2], [PC - 1], [PC]
+  for (uint8_t i = 0; i < 5; ++i) {
+    const uint8_t addr = static_cast<uint8_t>((pc - (4 - i)) & 0xFF);
+    msg += std::format("[{:0>3X}H]: {:0>3X}H\n", addr, tec.getMM(addr));
+  }
+  // SP
+  msg += std::format("SP: {:0>3X}H\n", sp);
+  // [SP - 2], [SP - 1], [SP], [SP + 1], [SP + 2]
+  for (uint8_t i = 0; i < 5; ++i) {
+    const uint8_t addr = static_cast<uint8_t>((sp - (4 - i)) & 0xFF);
+    msg += std::format("[{:0>3X}H]: {:0>3X}H\n", addr, tec.getMM(addr));
+  }
+  // G0, G1, G2, SP
+  msg += std::format("G0: {:0>3X}H, G1: {:0>3X}H, G2: {:0>3X}H, SP: {:0>3X}H\n",
+                     tec.getReg(Reg::G0), tec.getReg(Reg::G1),
+                     tec.getReg(Reg::G2), tec.getReg(Reg::SP));
+  // C, S, Z
+  msg += std::format("C: {}, S: {}, Z: {}", tec.getFlg(Flg::C) ? '1' : '0',
+                     tec.getFlg(Flg::S) ? '1' : '0',
+                     tec.getFlg(Flg::Z) ? '1' : '0');
+  return msg;
+}
+
+/// @brief 番地を名前表のラベルを使った表記にする。
+/// @param nameTable 名前表
+/// @param addr 番地
+/// @return "番地 (ラベル+オフセット)" の形式の文字列（ラベルがなければ番地のみ、
+/// ROM の番地なら "番地 (ROM)"）
+static inline std::string AddrToName(const NameTable &nameTable,
+                                     const uint8_t addr) {
+  // ROM のルーチンをプログラムの最後のラベルからの位置で表さない
+  if (TeC::RomStartAddr <= addr) {
+    return std::format("{:0>3X}H (ROM)", addr);
+  }
+  // addr 以下で最も近い番地のラベル（同じ番地なら名前順で最初のもの）
+  const std::pair<const std::string, uint8_t> *nearest = nullptr;
+  for (const auto &entry : nameTable) {
+    if (entry.second <= addr &&
+        (nearest == nullptr || nearest->second < entry.second ||
+         (nearest->second == entry.second && entry.first < nearest->first))) {
+      nearest = &entry;
+    }
+  }
+  if (nearest == nullptr) {
+    return std::format("{:0>3X}H", addr);
+  }
+  if (nearest->second == addr) {
+    return std::format("{:0>3X}H ({})", addr, nearest->first);
+  }
+  return std::format("{:0>3X}H ({}+{})", addr, nearest->first,
+                     addr - nearest->second);
+}
+
+/// @brief 入出力なしに永久に繰り返すループの範囲を求める。
+/// @param tec ループを検出した TeC
+/// @param nameTable 名前表
+/// @return エラーメッセージ
+static inline std::string LoopRange(TeC &tec, const NameTable &nameTable) {
+  std::string msg = "INFINITE LOOP.\nPC: ";
+  const std::vector<std::pair<uint8_t, uint8_t>> ranges = tec.traceLoop();
+  for (size_t i = 0; i < ranges.size(); ++i) {
+    const auto [lo, hi] = ranges[i];
+    if (i != 0) {
+      msg += ", ";
+    }
+    msg += AddrToName(nameTable, lo);
+    if (lo != hi) {
+      msg += " - " + AddrToName(nameTable, hi);
+    }
+  }
+  return msg;
+}
+
+/// @brief 実行したステート数と実行方式の段階ごとの統計を出力する。
+/// @param err 出力先
+/// @param tec TeC
+static inline void PrintStats(std::ostream &err, const TeC &tec) {
+  const TierStats &stats = tec.getStats();
+  auto us = [](const std::chrono::nanoseconds ns) -> double {
+    return std::chrono::duration<double, std::micro>(ns).count();
+  };
+  err << std::format("統計: ステート数 {}\n", tec.getTotalStates())
+      << std::format("  1命令ずつ実行: {} ステート\n", stats.stepStates)
+      << std::format("  基本ブロック: {} ステート, 変換 {} 回 "
+                     "({} 命令, {:.1f} us)\n",
+                     stats.blockStates, stats.translations,
+                     stats.translatedInsts, us(stats.translateTime))
+      << std::format("  機械語: {} ステート, 変換 {} 回 "
+                     "({} 命令, {:.1f} us)\n",
+                     stats.nativeStates, stats.compilations,
+                     stats.compiledInsts, us(stats.compileTime))
+      << std::format("  ROM ルーチン: {} ステート\n", stats.romStates)
+      << std::format("  書き換えによる無効化: {} ブロック\n",
+                     stats.invalidations);
+}
+
+/// @brief 読み込んだプログラム（同じプログラムの全てのケースで共有する）
+struct Program {
+  /// @brief 機械語
+  Source source;
+  /// @brief 名前表
+  NameTable nameTable;
+  /// @brief tec2c で C++ に変換したプログラム（なければ nullptr）
+  const AotInfo *aot;
+  /// @brief ゴールデンイメージ（プログラムを書き込んだ直後の TeC）
+  std::unique_ptr<const TeC> image;
+};
+
+/// @brief ゴールデンイメージ（プログラムを書き込んだ直後の TeC）を作る。
+/// @param source 機械語
+/// @param aot tec2c で C++ に変換したプログラム（なければ nullptr）
+/// @return ゴールデンイメージ
+static inline std::unique_ptr<const TeC> MakeImage(const Source &source,
+                                                   const AotInfo *aot) {
+  auto image = std::make_unique<TeC>();
+  image->writeProg(source.start, source.size, source.values);
+  if (aot != nullptr) {
+    image->setAot(*aot);
+  }
+  return image;
+}
+
+/// @brief プログラムを読み込み、ゴールデンイメージを作る。
+/// @param binPath 機械語のファイルのパス
+/// @param ntPath 名前表のファイルのパス（なければ nullptr）
+/// @param aot tec2c で C++ に変換したプログラム（なければ nullptr）
+/// @param err エラーメッセージの出力先
+/// @return プログラム（エラーがあれば出力して std::nullopt）
+static inline std::optional<Program> LoadProgram(const char *binPath,
+                                                 const char *ntPath,
+                                                 const AotInfo *aot,
+                                                 std::ostream &err) {
+  std::optional<Source> source = readSource(binPath, err);
+  if (not source) {
+    return std::nullopt;
+  }
+  if (aot != nullptr &&
+      (source->start != aot->start || source->size != aot->size ||
+       not std::equal(aot->values, aot->values + aot->size,
+                      source->values.begin()))) {
+    WriteError(err,
+               std::format("変換したプログラムと一致しません。 (パス: \"{}\")",
+                           binPath),
+               ErrorType::Binary);
+    return std::nullopt;
+  }
+  std::optional<NameTable> nameTable = NameTable{};
+  if (ntPath != nullptr) {
+    nameTable = ReadNameTable(ntPath, err);
+    if (not nameTable) {
+      return std::nullopt;
+    }
+  }
+  std::unique_ptr<const TeC> image = MakeImage(source.value(), aot);
+  return Program{.source = source.value(),
+                 .nameTable = std::move(nameTable).value(),
+                 .aot = aot,
+                 .image = std::move(image)};
+}
+
+/// @brief ケースごとに使い回す TeC の置き場
+/// @note
+/// 取り出すたびにゴールデンイメージと同じ状態に戻す（TeC::loadImage() を参照）。
+/// 同じプログラムの解読済み命令や機械語を、次のケースでもそのまま使える。
+class TeCPool {
+public:
+  /// @param image ゴールデンイメージ
+  explicit TeCPool(const TeC &image) : m_image(image), m_free() {}
+
+  /// @brief ゴールデンイメージと同じ状態の TeC を取り出す。
+  /// @return TeC（空きがなければ新しく作る）
+  std::unique_ptr<TeC> acquire() {
+    std::unique_ptr<TeC> tec;
+    if (m_free.empty()) {
+      tec = std::make_unique<TeC>();
+    } else {
+      tec = std::move(m_free.back());
+      m_free.pop_back();
+    }
+    tec->loadImage(m_image);
+    return tec;
+  }
+
+  /// @brief 使い終わった TeC を戻す。
+  /// @param tec TeC
+  void release(std::unique_ptr<TeC> tec) { m_free.push_back(std::move(tec)); }
+
+private:
+  /// @brief ゴールデンイメージ
+  const TeC &m_image;
+  /// @brief 空いている TeC
+  std::vector<std::unique_ptr<TeC>> m_free;
+};
+
+/// @brief ケースの実行の設定（コマンドラインのオプション）
+struct RunOptions {
+  /// @brief 命令の実行方式
+  Engine engine;
+  /// @brief シミュレーションするステート数の合計の上限
+  uint64_t maxStates;
+  /// @brief シミュレーションにかける実時間の上限（ミリ秒）
+  std::optional<uint64_t> timeoutMs;
+  /// @brief 終了時に統計を出力するか
+  bool printStats;
+};
+
+/// @brief 途中まで実行したケースの状態（CaseRunner::progress() を参照）
+struct CaseProgress {
+  /// @brief TeC の状態
+  TeCSnapshot tec;
+  /// @brief 実行できるステート数の合計の上限（$LIMIT を反映したもの）
+  uint64_t stateLimit;
+  /// @brief 表示待ちの出力
+  Printer::State printer;
+  /// @brief TeC に書き込んでいないシリアル入力
+  SerialInput::State serialIn;
+  /// @brief 実行にかかった時間
+  std::chrono::nanoseconds elapsed;
+};
+
+/// @brief 読み取り済みの TCL によるシミュレーション手順を1イベントずつ実行する。
+/// @note
+/// エラーでもプロセスを終了せずに戻るので、1つのプロセスで複数のケースを
+/// 続けて実行できる。イベント処理リストは書き換えないので、同じプログラムの
+/// 複数の実行で共有できる。
+/// @note
+/// 途中の状態を取り出して、別の CaseRunner で続きを実行できる
+/// （同じ手順で始まるケースの共通部分を1回だけ実行するため）。
+class CaseRunner {
+public:
+  /// @param program プログラム
+  /// @param options 実行の設定
+  /// @param tec プログラムのゴールデンイメージと同じ状態の TeC
+  /// @param out 出力先
+  /// @param err エラーメッセージと統計の出力先
+  CaseRunner(const Program &program, const RunOptions &options, TeC &tec,
+             std::ostream &out, std::ostream &err)
+      : m_program(program), m_options(options), m_tec(tec), m_out(out),
+        m_err(err), m_serialIn(), m_printer(out), m_serialOutBuf(),
+        m_begin(std::chrono::steady_clock::now()), m_elapsed(0) {
+    m_tec.setEngine(m_options.engine);
+    m_tec.setStateLimit(m_options.maxStates);
+    setDeadline();
+  }
+
+  /// @brief 途中まで実行した状態から続ける。
+  /// @param progress 状態（progress() を参照）
+  /// @return 続けられれば0、続けられなければ終了コード
+  /// （シリアル入力のファイルが開けなければ1）
+  int resume(CaseProgress &&progress) {
+    m_tec.restore(progress.tec);
+    m_tec.setStateLimit(progress.stateLimit);
+    m_printer.restore(std::move(progress.printer));
+    if (std::string path;
+        not m_serialIn.restore(std::move(progress.serialIn), path)) {
+      WriteError(
+          m_err,
+          std::format("ファイルが開けませんでした。 (パス: \"{}\")", path),
+          ErrorType::Input);
+      return 1;
+    }
+    m_begin = std::chrono::steady_clock::now();
+    m_elapsed = progress.elapsed;
+    setDeadline();
+    return 0;
+  }
+
+  /// @brief 途中まで実行した状態を取り出す。
+  /// @return 状態（出力先に出力済みの内容は含まない）
+  CaseProgress progress() {
+    return CaseProgress{
+        .tec = m_tec.snapshot(),
+        .stateLimit = m_tec.getStateLimit(),
+        .printer = m_printer.state(),
+        .serialIn = m_serialIn.state(),
+        .elapsed = m_elapsed + (std::chrono::steady_clock::now() - m_begin)};
+  }
+
+  /// @brief 1つのイベントを実行する。
+  /// @param event イベント
+  /// @return 続けられれば0、続けられなければ終了コード（エラーなら1、
+  /// 実行の制限に達したら LimitExitCode）
+  int exec(const Event &event) {
+    switch (event.type) {
+    case EventType::SetReg: {
+      const SetRegEvent &e = static_cast<const SetRegEvent &>(event);
+      m_tec.setReg(e.reg, e.value);
+    } break;
+    case EventType::SetFlg: {
+      const SetFlgEvent &e = static_cast<const SetFlgEvent &>(event);
+      m_tec.setFlg(e.flg, e.val);
+    } break;
+    case EventType::SetMM: {
+      const SetMMEvent &e = static_cast<const SetMMEvent &>(event);
+      m_tec.setMM(e.addr, e.val);
+    } break;
+    case EventType::SetDataSW: {
+      const SetDataSWEvent &e = static_cast<const SetDataSWEvent &>(event);
+      m_tec.setDataSW(e.val);
+    } break;
+    case EventType::SetSerialMode: {
+      const SetSerialModeEvent &e =
+          static_cast<const SetSerialModeEvent &>(event);
+      m_printer.setSerialMode(e.mode);
+    } break;
+    case EventType::SetPrintMode: {
+      const SetPrintModeEvent &e =
+          static_cast<const SetPrintModeEvent &>(event);
+      m_printer.setPrintMode(e.mode);
+    } break;
+    case EventType::Run:
+      m_tec.run();
+      break;
+    case EventType::Stop:
+      m_tec.stop();
+      break;
+    case EventType::Reset:
+      m_tec.reset();
+      break;
+    case EventType::PrintReg: {
+      const PrintRegEvent &e = static_cast<const PrintRegEvent &>(event);
+      m_printer.print(m_tec.getReg(e.reg));
+    } break;
+    case EventType::PrintFlg: {
+      const PrintFlgEvent &e = static_cast<const PrintFlgEvent &>(event);
+      m_printer.print(m_tec.getFlg(e.flg) ? 1 : 0);
+    } break;
+    case EventType::PrintMM: {
+      const PrintMMEvent &e = static_cast<const PrintMMEvent &>(event);
+      m_printer.print(m_tec.getMM(e.addr));
+    } break;
+    case EventType::WaitStates: {
+      const WaitStatesEvent &e =
+          static_cast<const WaitStatesEvent &>(event);
+      uint64_t states = 0;
+      while (states < e.states && m_tec.isRunning()) {
+        states += m_tec.clockUntilIO(e.states - states, not m_serialIn.empty());
+        transferSerial();
+        if (const int code = check(); code != 0) {
+          return code;
+        }
+      }
+    } break;
+    case EventType::WaitSerial: {
+      while (m_tec.isRunning() &&
+             (m_tec.hasSerialIn() || not m_serialIn.empty())) {
+        m_tec.clockUntilIO(UINT64_MAX, true);
+        transferSerial();
+        if (const int code = check(); code != 0) {
+          return code;
+        }
+      }
+    } break;
+    case EventType::WaitStop:
+      while (m_tec.isRunning()) {
+        m_tec.clockUntilIO(UINT64_MAX, not m_serialIn.empty());
+        transferSerial();
+        if (const int code = check(); code != 0) {
+          return code;
+        }
+      }
+      break;
+    case EventType::LimitStates: {
+      const LimitStatesEvent &e =
+          static_cast<const LimitStatesEvent &>(event);
+      // 以降に実行するステート数の上限（コマンドラインの上限は超えない）
+      const uint64_t total = m_tec.getTotalStates();
+      m_tec.setStateLimit(std::min(m_options.maxStates,
+                                 e.states < UINT64_MAX - total
+                                     ? total + e.states
+                                     : UINT64_MAX));
+    } break;
+    case EventType::Serial: {
+      const SerialEvent &e = static_cast<const SerialEvent &>(event);
+      m_serialIn.push(e.value);
+      m_serialIn.feed(m_tec);
+    } break;
+    case EventType::SerialFile: {
+      const SerialFileEvent &e =
+          static_cast<const SerialFileEvent &>(event);
+      if (not m_serialIn.pushFile(e.path)) {
+        WriteError(
+            m_err,
+            std::format("ファイルが開けませんでした。 (パス: \"{}\")", e.path),
+            ErrorType::Input);
+        return 1;
+      }
+      m_serialIn.feed(m_tec);
+    } break;
+    case EventType::Write: {
+      if (not m_tec.isRunning()) {
+        WriteError(m_err, "TeC is not running.", ErrorType::Program);
+        return 1;
+      }
+      m_tec.write();
+    } break;
+    case EventType::ParallelWrite: {
+      const ParallelWriteEvent &e =
+          static_cast<const ParallelWriteEvent &>(event);
+      m_tec.writeParallel(e.value);
+    } break;
+    case EventType::PrintParallel:
+      m_printer.print(m_tec.readParallel());
+      break;
+    case EventType::PrintExtParallel:
+      m_printer.print(m_tec.readExtParallel());
+      break;
+    case EventType::PrintBuz:
+      m_printer.print(m_tec.getBuz() ? 1 : 0);
+      break;
+    case EventType::PrintSpk:
+      m_printer.print(m_tec.getSpk() ? 1 : 0);
+      break;
+    case EventType::PrintRun:
+      m_printer.print(m_tec.isRunning() ? 1 : 0);
+      break;
+    case EventType::Analog: {
+      const AnalogEvent &e = static_cast<const AnalogEvent &>(event);
+      m_tec.writeAnalog(e.pin, e.value);
+    } break;
+    case EventType::Save: {
+      const SnapshotEvent &e = static_cast<const SnapshotEvent &>(event);
+      // 保存までの出力は、このケースの出力として書き出す
+      m_printer.flush();
+      const CaseSnapshot snap{.tec = m_tec.snapshot(),
+                              .serialMode = m_printer.serialMode(),
+                              .printMode = m_printer.printMode(),
+                              .serialIn = m_serialIn.pending()};
+      std::ofstream ofs{e.path, std::ios_base::binary};
+      if (ofs) {
+        WriteSnapshot(ofs, snap);
+        ofs.close();
+      }
+      if (not ofs) {
+        WriteError(
+            m_err,
+            std::format("ファイルに書き込めませんでした。 (パス: \"{}\")",
+                        e.path),
+            ErrorType::Input);
+        return 1;
+      }
+    } break;
+    case EventType::Load: {
+      const SnapshotEvent &e = static_cast<const SnapshotEvent &>(event);
+      std::ifstream ifs{e.path, std::ios_base::binary};
+      if (not ifs) {
+        WriteError(
+            m_err,
+            std::format("ファイルが開けませんでした。 (パス: \"{}\")", e.path),
+            ErrorType::Input);
+        return 1;
+      }
+      std::optional<CaseSnapshot> snap = ReadSnapshot(ifs);
+      if (not snap) {
+        WriteError(m_err,
+                   std::format("スナップショットの形式が不正です。 "
+                               "(パス: \"{}\")",
+                               e.path),
+                   ErrorType::Input);
+        return 1;
+      }
+      m_printer.flush();
+      m_printer.setSerialMode(snap->serialMode);
+      m_printer.setPrintMode(snap->printMode);
+      m_tec.restore(snap->tec);
+      m_serialIn.restore(std::move(snap->serialIn));
+    } break;
+    }
+    return 0;
+  }
+
+  /// @brief 全てのイベントを実行した後に、出力をフラッシュする。
+  /// @return 終了コード（0）
+  int finish() {
+    m_printer.flush();
+    m_out << std::flush;
+    if (m_options.printStats) {
+      PrintStats(m_err, m_tec);
+    }
+    assert(not m_tec.isRunning());
+    return 0;
+  }
+
+private:
+  const Program &m_program;
+  const RunOptions &m_options;
+  TeC &m_tec;
+  std::ostream &m_out;
+  std::ostream &m_err;
+  SerialInput m_serialIn;
+  Printer m_printer;
+  std::array<uint8_t, TeC::SerialFifoSize> m_serialOutBuf;
+  /// @brief 実行を始めた（続けた）時刻
+  std::chrono::steady_clock::time_point m_begin;
+  /// @brief 続ける前までの実行にかかった時間
+  std::chrono::nanoseconds m_elapsed;
+
+  /// @brief 実行を打ち切る時刻を設定する（続ける前までの時間を差し引く）。
+  void setDeadline() {
+    if (m_options.timeoutMs) {
+      const std::chrono::nanoseconds timeout = std::chrono::milliseconds(
+          std::min<uint64_t>(m_options.timeoutMs.value(), INT32_MAX));
+      m_tec.setDeadline(m_begin + std::max(timeout - m_elapsed,
+                                           std::chrono::nanoseconds(0)));
+    }
+  }
+
+  /// @brief シリアル出力 FIFO を読み出して表示する。
+  void readSerialOut() {
+    while (const size_t n = m_tec.readSerialOut(m_serialOutBuf.data(),
+                                                m_serialOutBuf.size())) {
+      for (size_t j = 0; j < n; ++j) {
+        m_printer.serial(m_serialOutBuf[j]);
+      }
+    }
+  }
+
+  /// @brief シリアル入出力の FIFO を読み書きし、止まっていた受け渡しを続ける。
+  void transferSerial() {
+    readSerialOut();
+    m_serialIn.feed(m_tec);
+    m_tec.resumeSerial();
+    readSerialOut();
+  }
+
+  /// @brief 実行を続けられなければ、エラーメッセージを出力して終了コードを返す。
+  /// @return 続けられれば0
+  int check() {
+    const bool error = m_tec.isError();
+    const Limit limit = m_tec.exceededLimit();
+    if (not error && limit == Limit::None && not m_tec.isLooping()) {
+      return 0;
+    }
+    if (m_options.printStats) {
+      PrintStats(m_err, m_tec);
+    }
+    if (error) {
+      WriteError(m_err, StackTrace(m_tec), ErrorType::Program);
+      return 1;
+    }
+    if (limit != Limit::None) {
+      // 制限に達するまでの出力を残す
+      m_printer.flush();
+      m_out << std::flush;
+      WriteError(m_err,
+                 limit == Limit::States ? "STATE LIMIT EXCEEDED."
+                                        : "TIME LIMIT EXCEEDED.",
+                 ErrorType::Program);
+      return LimitExitCode;
+    }
+    WriteError(m_err, LoopRange(m_tec, m_program.nameTable),
+               ErrorType::Program);
+    return 1;
+  }
+};
+
+/// @brief 読み取り済みの TCL によるシミュレーション手順を実行する。
+/// @param program プログラム
+/// @param options 実行の設定
+/// @param tec プログラムのゴールデンイメージと同じ状態の TeC
+/// @param events イベント処理リスト（ReadInput() を参照）
+/// @param out 出力先
+/// @param err エラーメッセージと統計の出力先
+/// @return 終了コード（正常なら0、エラーなら1、実行の制限に達したら
+/// LimitExitCode）
+static inline int RunEvents(const Program &program, const RunOptions &options,
+                            TeC &tec, const EventList &events,
+                            std::ostream &out, std::ostream &err) {
+  CaseRunner runner{program, options, tec, out, err};
+  for (const std::unique_ptr<Event> &event : events) {
+    if (const int code = runner.exec(*event); code != 0) {
+      return code;
+    }
+  }
+  return runner.finish();
+}
+
+/// @brief 1つのケース（TCL によるシミュレーション手順）を実行する。
+/// @param program プログラム
+/// @param options 実行の設定
+/// @param tec プログラムのゴールデンイメージと同じ状態の TeC
+/// @param in TCL の入力
+/// @param out 出力先
+/// @param err エラーメッセージと統計の出力先
+/// @return 終了コード（RunEvents() を参照、TCL にエラーがあれば1）
+static inline int RunCase(const Program &program, const RunOptions &options,
+                          TeC &tec, std::istream &in, std::ostream &out,
+                          std::ostream &err) {
+  const std::optional<EventList> events =
+      ReadInput(in, err, program.nameTable);
+  if (not events) {
+    return 1;
+  }
+  return RunEvents(program, options, tec, events.value(), out, err);
+}
+
+/// @brief ケースの入力ファイルのパスから出力ファイルのパスを求める。
+/// @param path 入力ファイルのパス（<case>.in）
+/// @return 出力ファイルのパス（<case>.dst）
+static inline std::string DstPath(std::string path) {
+  if (path.ends_with(".in")) {
+    path.erase(path.end() - 3, path.end());
+  }
+  return path + ".dst";
+}
+
+/// @brief --cases の引数からケースの入力ファイルのパスを求める。
+/// @param args ケースの入力ファイルまたはディレクトリのパス
+/// @return ケースの入力ファイルのパス（ディレクトリはその中の *.in を名前順に）
+static inline std::vector<std::string>
+ExpandCases(const std::vector<const char *> &args) {
+  std::vector<std::string> cases;
+  for (const char *arg : args) {
+    std::error_code ec;
+    if (not std::filesystem::is_directory(arg, ec)) {
+      cases.emplace_back(arg);
+      continue;
+    }
+    std::vector<std::string> files;
+    for (const std::filesystem::directory_entry &entry :
+         std::filesystem::directory_iterator(arg, ec)) {
+      if (entry.path().extension() == ".in" && not entry.is_directory(ec)) {
+        files.emplace_back(entry.path().string());
+      }
+    }
+    std::sort(files.begin(), files.end());
+    cases.insert(cases.end(), files.begin(), files.end());
+  }
+  return cases;
+}
+
+/// @brief 1つのケースの実行結果
+struct CaseResult {
+  /// @brief 終了コード
+  int exitCode;
+  /// @brief 出力
+  std::string out;
+  /// @brief エラーメッセージと統計
+  std::string err;
+};
+
+/// @brief 同じイベントかどうかを比べるためのキーを求める。
+/// @param event イベント
+/// @return キー（種類と引数を並べたバイト列）
+static inline std::string EventKey(const Event &event) {
+  std::string key(1, static_cast<char>(event.type));
+  auto put = [&](const uint64_t val, const size_t bytes) -> void {
+    for (size_t i = 0; i < bytes; ++i) {
+      key += static_cast<char>(val >> (8 * i));
+    }
+  };
+  switch (event.type) {
+  case EventType::PrintFlg:
+    put(static_cast<uint8_t>(static_cast<const PrintFlgEvent &>(event).flg), 1);
+    break;
+  case EventType::PrintReg:
+    put(static_cast<uint8_t>(static_cast<const PrintRegEvent &>(event).reg), 1);
+    break;
+  case EventType::PrintMM:
+    put(static_cast<const PrintMMEvent &>(event).addr, 1);
+    break;
+  case EventType::SetReg: {
+    const SetRegEvent &e = static_cast<const SetRegEvent &>(event);
+    put(static_cast<uint8_t>(e.reg), 1);
+    put(e.value, 1);
+  } break;
+  case EventType::SetFlg: {
+    const SetFlgEvent &e = static_cast<const SetFlgEvent &>(event);
+    put(static_cast<uint8_t>(e.flg), 1);
+    put(e.val ? 1 : 0, 1);
+  } break;
+  case EventType::SetMM: {
+    const SetMMEvent &e = static_cast<const SetMMEvent &>(event);
+    put(e.addr, 1);
+    put(e.val, 1);
+  } break;
+  case EventType::SetDataSW:
+    put(static_cast<const SetDataSWEvent &>(event).val, 1);
+    break;
+  case EventType::SetSerialMode:
+    put(static_cast<uint8_t>(
+            static_cast<const SetSerialModeEvent &>(event).mode),
+        1);
+    break;
+  case EventType::SetPrintMode:
+    put(static_cast<uint8_t>(
+            static_cast<const SetPrintModeEvent &>(event).mode),
+        1);
+    break;
+  case EventType::Serial: {
+    const SerialEvent &e = static_cast<const SerialEvent &>(event);
+    key.append(e.value.begin(), e.value.end());
+  } break;
+  case EventType::SerialFile:
+    key += static_cast<const SerialFileEvent &>(event).path;
+    break;
+  case EventType::Save:
+  case EventType::Load:
+    key += static_cast<const SnapshotEvent &>(event).path;
+    break;
+  case EventType::WaitStates:
+    put(static_cast<const WaitStatesEvent &>(event).states, 8);
+    break;
+  case EventType::LimitStates:
+    put(static_cast<const LimitStatesEvent &>(event).states, 8);
+    break;
+  case EventType::Analog: {
+    const AnalogEvent &e = static_cast<const AnalogEvent &>(event);
+    put(e.pin, 1);
+    put(e.value, 1);
+  } break;
+  case EventType::ParallelWrite:
+    put(static_cast<const ParallelWriteEvent &>(event).value, 1);
+    break;
+  default:
+    break;
+  }
+  return key;
+}
+
+/// @brief ケースのイベント処理リストの接頭辞木の節
+/// @note
+/// 根から節までのイベントの列が、その節以下のケースに共通する接頭辞になる。
+struct PrefixNode {
+  /// @brief この節で実行するイベント（根は nullptr）
+  const Event *event;
+  /// @brief イベント処理リストがこの節で終わるケースの添字
+  std::vector<size_t> ends;
+  /// @brief 子
+  std::vector<std::unique_ptr<PrefixNode>> children;
+  /// @brief 子のイベントのキー（EventKey() を参照）から子の添字への写像
+  std::unordered_map<std::string, size_t> index;
+
+  /// @brief ケースのイベント処理リストを加える。
+  /// @param events イベント処理リスト
+  /// @param testCase ケースの添字
+  /// @param share 他のケースと接頭辞を共有するか
+  void insert(const EventList &events, const size_t testCase,
+              const bool share) {
+    PrefixNode *node = this;
+    for (size_t i = 0; i < events.size(); ++i) {
+      const Event &event = *events[i];
+      std::string key = EventKey(event);
+      const auto it = share || i != 0 ? node->index.find(key)
+                                      : node->index.end();
+      if (it != node->index.end()) {
+        node = node->children[it->second].get();
+        continue;
+      }
+      if (share || i != 0) {
+        node->index.emplace(std::move(key), node->children.size());
+      }
+      node->children.emplace_back(std::make_unique<PrefixNode>(
+          PrefixNode{.event = &event, .ends = {}, .children = {}, .index = {}}));
+      node = node->children.back().get();
+    }
+    node->ends.emplace_back(testCase);
+  }
+
+  /// @brief この節以下で終わるケースの添字を求める。
+  /// @param cases ケースの添字の追加先
+  void collect(std::vector<size_t> &cases) const {
+    cases.insert(cases.end(), ends.begin(), ends.end());
+    for (const std::unique_ptr<PrefixNode> &child : children) {
+      child->collect(cases);
+    }
+  }
+};
+
+/// @brief 複数のケースを1つのプロセスで並列に実行する（--cases）。
+/// @param program プログラム（全てのケースで共有する）
+/// @param options 実行の設定
+/// @param cases ケースの入力ファイルのパス
+/// @param jobs 同時に実行するスレッドの数（1以上）
+/// @param combined 各ケースの出力を標準出力にまとめて出力するか
+/// @return 各ケースの終了コードのうち最大のもの
+/// @note
+/// 各ケースの出力は <case>.dst に書き込む（combined なら、ケースのパスを
+/// 示す行に続けて標準出力に出力する）。エラーメッセージと統計は、
+/// ケースのパスに続けて標準エラー出力に出力する。
+/// どちらもケースの順に出力するので、並列に実行しても結果は変わらない。
+/// @note
+/// 全てのケースのイベント処理リストで接頭辞木を作り、共通の接頭辞は1回だけ
+/// 実行する。分岐する節で実行の状態（CaseProgress）を取り出し、各分岐は
+/// その写しから続ける。--timeout-ms の時間には共通の接頭辞の実行時間も含める。
+/// 統計を出力する場合は、ケースごとに数えるため共有しない。
+/// @note
+/// TeC の置き場はスレッドごとに持つ。
+static inline int RunCases(const Program &program, const RunOptions &options,
+                           const std::vector<std::string> &cases,
+                           const unsigned int jobs, const bool combined) {
+  std::vector<CaseResult> results(cases.size());
+  // イベント処理リストを読み取り、接頭辞木を作る
+  std::vector<EventList> eventLists(cases.size());
+  PrefixNode root{.event = nullptr, .ends = {}, .children = {}, .index = {}};
+  for (size_t i = 0; i < cases.size(); ++i) {
+    CaseResult &result = results[i];
+    result.exitCode = 1;
+    std::ostringstream err;
+    std::ifstream ifs{cases[i]};
+    if (not ifs) {
+      WriteError(err,
+                 std::format("ファイルが開けませんでした。 (パス: \"{}\")",
+                             cases[i]),
+                 ErrorType::Input);
+      result.err = err.str();
+      continue;
+    }
+    std::optional<EventList> events = ReadInput(ifs, err, program.nameTable);
+    result.err = err.str();
+    if (events) {
+      eventLists[i] = std::move(events).value();
+      root.insert(eventLists[i], i, not options.printStats);
+    } else if (not combined) {
+      // 実行できなくても、空の <case>.dst は作る
+      std::ofstream ofs{DstPath(cases[i])};
+    }
+  }
+  // 接頭辞木の節から実行を続ける作業
+  struct Task {
+    const PrefixNode *node;
+    std::optional<CaseProgress> progress;
+    std::string out;
+    std::string err;
+  };
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::deque<Task> tasks;
+  // 待っているか実行中の作業の数
+  size_t outstanding = 0;
+  auto push = [&](Task &&task) -> void {
+    {
+      const std::lock_guard<std::mutex> lock{mutex};
+      tasks.emplace_back(std::move(task));
+      ++outstanding;
+    }
+    cv.notify_one();
+  };
+  auto run = [&](TeCPool &pool, Task &&task) -> void {
+    std::unique_ptr<TeC> tec = pool.acquire();
+    std::ostringstream out{std::move(task.out), std::ios_base::ate};
+    std::ostringstream err{std::move(task.err), std::ios_base::ate};
+    CaseRunner runner{program, options, *tec, out, err};
+    // 節で終わるケースに結果を書き込む
+    auto store = [&](const std::vector<size_t> &ends, const int code,
+                     const std::string &caseOut) -> void {
+      for (const size_t i : ends) {
+        results[i] =
+            CaseResult{.exitCode = code, .out = caseOut, .err = err.str()};
+      }
+    };
+    if (task.progress) {
+      if (const int code = runner.resume(std::move(task.progress).value());
+          code != 0) {
+        std::vector<size_t> ends;
+        task.node->collect(ends);
+        store(ends, code, out.str());
+        pool.release(std::move(tec));
+        return;
+      }
+    }
+    for (const PrefixNode *node = task.node;;) {
+      if (node->event != nullptr) {
+        if (const int code = runner.exec(*node->event); code != 0) {
+          std::vector<size_t> ends;
+          node->collect(ends);
+          store(ends, code, out.str());
+          break;
+        }
+      }
+      if (node->children.empty()) {
+        const int code = runner.finish();
+        store(node->ends, code, out.str());
+        break;
+      }
+      if (node->ends.empty() && node->children.size() == 1) {
+        node = node->children.front().get();
+        continue;
+      }
+      // 分岐する節: 状態の写しから各分岐を続ける（最後の分岐はこのまま）
+      const CaseProgress progress = runner.progress();
+      if (not node->ends.empty()) {
+        std::ostringstream endOut{out.str(), std::ios_base::ate};
+        Printer printer{endOut};
+        printer.restore(Printer::State{progress.printer});
+        printer.flush();
+        store(node->ends, 0, endOut.str());
+      }
+      for (size_t k = 0; k + 1 < node->children.size(); ++k) {
+        push(Task{.node = node->children[k].get(),
+                  .progress = progress,
+                  .out = out.str(),
+                  .err = err.str()});
+      }
+      node = node->children.back().get();
+    }
+    pool.release(std::move(tec));
+  };
+  auto worker = [&]() -> void {
+    TeCPool pool{*program.image};
+    std::unique_lock<std::mutex> lock{mutex};
+    while (true) {
+      cv.wait(lock, [&]() { return not tasks.empty() || outstanding == 0; });
+      if (tasks.empty()) {
+        break;
+      }
+      Task task = std::move(tasks.front());
+      tasks.pop_front();
+      lock.unlock();
+      run(pool, std::move(task));
+      lock.lock();
+      if (--outstanding == 0) {
+        cv.notify_all();
+      }
+    }
+  };
+  if (not root.children.empty() || not root.ends.empty()) {
+    push(Task{.node = &root, .progress = std::nullopt, .out = {}, .err = {}});
+  }
+  {
+    std::vector<std::jthread> threads;
+    const size_t n = std::min<size_t>(jobs, cases.size());
+    for (size_t i = 1; i < n; ++i) {
+      threads.emplace_back(worker);
+    }
+    worker();
+  }
+  int exitCode = 0;
+  for (size_t i = 0; i < cases.size(); ++i) {
+    CaseResult &result = results[i];
+    if (combined) {
+      std::cout << std::format("==> {} <==\n", cases[i]) << result.out
+                << std::flush;
+    } else if (eventLists[i].empty()) {
+      // 読み取れなかったケース
+    } else if (const std::string dst = DstPath(cases[i]);
+               std::ofstream ofs{dst}) {
+      ofs << result.out;
+    } else {
+      std::ostringstream err;
+      WriteError(err,
+                 std::format("ファイルが開けませんでした。 (パス: \"{}\")",
+                             dst),
+                 ErrorType::Input);
+      result = CaseResult{.exitCode = 1, .out = {}, .err = err.str()};
+    }
+    if (not result.err.empty()) {
+      std::cerr << std::format("{}:\n", cases[i]) << result.err;
+    }
+    exitCode = std::max(exitCode, result.exitCode);
+  }
+  return exitCode;
+}
+
+#if TEC_SERVE
+/// @brief ソケットに全て書き込む。
+/// @param fd ソケット
+/// @param data 書き込む内容
+/// @return 接続が切れていれば false
+static inline bool SendAll(const int fd, std::string_view data) {
+  while (not data.empty()) {
+    const ssize_t n = ::write(fd, data.data(), data.size());
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    data.remove_prefix(static_cast<size_t>(n));
+  }
+  return true;
+}
+
+/// @brief 書き込んだ内容を "<タグ> <バイト数>\n<内容>" の形でソケットに送る
+/// ストリームバッファ
+/// @note バッファが満杯になるか、フラッシュされるたびに送る。
+class FrameBuf : public std::streambuf {
+public:
+  /// @param fd ソケット
+  /// @param tag タグ（OUT または ERR）
+  FrameBuf(const int fd, const char *tag)
+      : m_fd(fd), m_tag(tag), m_buf(), m_ok(true) {
+    setp(m_buf.data(), m_buf.data() + m_buf.size());
+  }
+
+protected:
+  int_type overflow(const int_type ch) override {
+    if (sync() != 0) {
+      return traits_type::eof();
+    }
+    if (not traits_type::eq_int_type(ch, traits_type::eof())) {
+      *pptr() = traits_type::to_char_type(ch);
+      pbump(1);
+    }
+    return traits_type::not_eof(ch);
+  }
+
+  int sync() override {
+    if (const size_t size = static_cast<size_t>(pptr() - pbase()); size != 0) {
+      m_ok = m_ok && SendAll(m_fd, std::format("{} {}\n", m_tag, size)) &&
+             SendAll(m_fd, {pbase(), size});
+      setp(m_buf.data(), m_buf.data() + m_buf.size());
+    }
+    return m_ok ? 0 : -1;
+  }
+
+private:
+  int m_fd;
+  const char *m_tag;
+  std::array<char, 4096> m_buf;
+  /// @brief 接続が切れていないか
+  bool m_ok;
+};
+
+/// @brief ソケットから行やバイト列を読む。
+class SocketReader {
+public:
+  /// @param fd ソケット
+  explicit SocketReader(const int fd) : m_fd(fd), m_buf(), m_pos(0) {}
+
+  /// @brief 1行読む。
+  /// @return 行（改行を含まない、接続が切れたら std::nullopt）
+  std::optional<std::string> readLine() {
+    for (;;) {
+      if (const size_t end = m_buf.find('\n', m_pos); end != std::string::npos) {
+        std::string line = m_buf.substr(m_pos, end - m_pos);
+        m_pos = end + 1;
+        if (line.ends_with('\r')) {
+          line.pop_back();
+        }
+        return line;
+      }
+      if (not fill()) {
+        return std::nullopt;
+      }
+    }
+  }
+
+  /// @brief バイト列を読む。
+  /// @param size バイト数
+  /// @return バイト列（接続が切れたら std::nullopt）
+  std::optional<std::string> readBytes(const size_t size) {
+    while (m_buf.size() - m_pos < size) {
+      if (not fill()) {
+        return std::nullopt;
+      }
+    }
+    std::string bytes = m_buf.substr(m_pos, size);
+    m_pos += size;
+    return bytes;
+  }
+
+private:
+  int m_fd;
+  std::string m_buf;
+  /// @brief m_buf の読み終えた位置
+  size_t m_pos;
+
+  bool fill() {
+    m_buf.erase(0, m_pos);
+    m_pos = 0;
+    std::array<char, 4096> chunk;
+    ssize_t n = 0;
+    do {
+      n = ::read(m_fd, chunk.data(), chunk.size());
+    } while (n < 0 && errno == EINTR);
+    if (n <= 0) {
+      return false;
+    }
+    m_buf.append(chunk.data(), static_cast<size_t>(n));
+    return true;
+  }
+};
+
+/// @brief 読み取り済みの TCL（ケースとプログラムの組ごと）
+struct CompiledScript {
+  /// @brief 読み取ったプログラム（名前表でラベルを解決する）
+  std::shared_ptr<const Program> program;
+  /// @brief 読み取ったケースの TCL
+  std::shared_ptr<const std::string> text;
+  /// @brief イベント処理リスト（エラーがあれば std::nullopt）
+  std::optional<EventList> events;
+  /// @brief エラーメッセージ
+  std::string errors;
+};
+
+/// @brief 常駐モードで読み込んだプログラムとケース（全ての接続で共有する）
+struct ServeRegistry {
+  std::mutex mutex;
+  /// @brief プログラム ID ごとのプログラム
+  std::unordered_map<std::string, std::shared_ptr<const Program>> programs;
+  /// @brief ケース ID ごとの TCL
+  std::unordered_map<std::string, std::shared_ptr<const std::string>> cases;
+  /// @brief "<プログラム ID> <ケース ID>" ごとの読み取り済みの TCL
+  std::unordered_map<std::string, std::shared_ptr<const CompiledScript>>
+      scripts;
+};
+
+/// @brief 1つの接続の要求を順に処理する。
+/// @param registry 読み込んだプログラムとケース
+/// @param options 実行の設定
+/// @param aot tec2c で C++ に変換したプログラム（なければ nullptr）
+/// @param fd ソケット（終わったら閉じる）
+/// @note
+/// 要求は1行ずつ（TCL は続けてそのバイト数だけ）送る。応答は、
+/// 出力とエラーメッセージを "OUT <バイト数>", "ERR <バイト数>" の行に続けて
+/// 送り、最後に "EXIT <終了コード>" の行を送る。
+/// 応答を待たずに続けて要求を送ってもよい。
+/// TCL のバイト数が不正なら、後続の要求の区切りが分からないので、
+/// 応答してから接続を切る（TCL の途中で接続が切れた場合は応答しない）。
+static inline void ServeConnection(ServeRegistry &registry,
+                                   const RunOptions &options,
+                                   const AotInfo *aot, const int fd) {
+  SocketReader reader{fd};
+  // プログラム ID ごとの TeC の置き場（読み込み直したら作り直す）
+  std::unordered_map<std::string,
+                     std::pair<std::shared_ptr<const Program>,
+                               std::unique_ptr<TeCPool>>>
+      pools;
+  bool connected = true;
+  // この要求に応答したら接続を切るか
+  bool closing = false;
+  while (connected && not closing) {
+    const std::optional<std::string> line = reader.readLine();
+    if (not line) {
+      break;
+    }
+    std::istringstream words{line.value()};
+    std::string cmd;
+    std::string arg1;
+    std::string arg2;
+    std::string arg3;
+    std::string arg4;
+    words >> cmd >> arg1 >> arg2 >> arg3 >> arg4;
+    if (cmd.empty()) {
+      continue;
+    }
+    FrameBuf outBuf{fd, "OUT"};
+    FrameBuf errBuf{fd, "ERR"};
+    std::ostream out{&outBuf};
+    std::ostream err{&errBuf};
+    int code = 1;
+    if (cmd == "TCL" && not arg2.empty() && arg3.empty() &&
+        not StrToUInt64(arg2)) {
+      WriteError(err,
+                 std::format("不正な要求です。 (要求: \"{}\")", line.value()),
+                 ErrorType::Input);
+      closing = true;
+    } else if (cmd == "DROP" && (arg1 == "PROGRAM" || arg1 == "CASE") &&
+               not arg2.empty() && arg3.empty()) {
+      // DROP PROGRAM <プログラム ID>, DROP CASE <ケース ID>
+      // （そのプログラムまたはケースの読み取り済みの TCL も捨てる）
+      const bool isProgram = arg1 == "PROGRAM";
+      const std::lock_guard<std::mutex> lock{registry.mutex};
+      if (isProgram ? registry.programs.erase(arg2) != 0
+                    : registry.cases.erase(arg2) != 0) {
+        std::erase_if(registry.scripts, [&](const auto &script) -> bool {
+          const std::string &key = script.first;
+          const size_t sep = key.find(' ');
+          return isProgram ? key.substr(0, sep) == arg2
+                           : key.substr(sep + 1) == arg2;
+        });
+        if (isProgram) {
+          pools.erase(arg2);
+        }
+        code = 0;
+      } else {
+        WriteError(err,
+                   std::format("{}が読み込まれていません。 ({} ID: \"{}\")",
+                               isProgram ? "プログラム" : "ケース",
+                               isProgram ? "プログラム" : "ケース", arg2),
+                   ErrorType::Input);
+      }
+    } else if (cmd == "LOAD" && not arg2.empty() && arg4.empty()) {
+      // LOAD <プログラム ID> <program>.bin [<program>.nt]
+      if (std::optional<Program> program = LoadProgram(
+              arg2.c_str(), arg3.empty() ? nullptr : arg3.c_str(), aot, err)) {
+        const std::lock_guard<std::mutex> lock{registry.mutex};
+        registry.programs[arg1] =
+            std::make_shared<const Program>(std::move(program).value());
+        code = 0;
+      }
+    } else if (cmd == "CASE" && not arg2.empty() && arg3.empty()) {
+      // CASE <ケース ID> <case>.in
+      if (std::ifstream ifs{arg2}; ifs) {
+        std::ostringstream text;
+        text << ifs.rdbuf();
+        const std::lock_guard<std::mutex> lock{registry.mutex};
+        registry.cases[arg1] = std::make_shared<const std::string>(text.str());
+        code = 0;
+      } else {
+        WriteError(err,
+                   std::format("ファイルが開けませんでした。 (パス: \"{}\")",
+                               arg2),
+                   ErrorType::Input);
+      }
+    } else if ((cmd == "RUN" || cmd == "TCL") && not arg2.empty() &&
+               arg3.empty()) {
+      // RUN <プログラム ID> <ケース ID>
+      // TCL <プログラム ID> <バイト数>（続けて TCL）
+      std::optional<std::string> inlineTcl;
+      if (cmd == "TCL") {
+        inlineTcl = reader.readBytes(StrToUInt64(arg2).value());
+        if (not inlineTcl) {
+          // TCL の途中で接続が切れた
+          break;
+        }
+      }
+      std::shared_ptr<const Program> program;
+      std::shared_ptr<const std::string> text;
+      std::shared_ptr<const CompiledScript> script;
+      {
+        const std::lock_guard<std::mutex> lock{registry.mutex};
+        if (const auto it = registry.programs.find(arg1);
+            it != registry.programs.end()) {
+          program = it->second;
+        }
+        if (const auto it = registry.cases.find(arg2);
+            cmd == "RUN" && it != registry.cases.end()) {
+          text = it->second;
+        }
+        if (const auto it = registry.scripts.find(arg1 + ' ' + arg2);
+            cmd == "RUN" && it != registry.scripts.end() &&
+            it->second->program == program && it->second->text == text) {
+          script = it->second;
+        }
+      }
+      if (program == nullptr) {
+        WriteError(err,
+                   std::format("プログラムが読み込まれていません。 "
+                               "(プログラム ID: \"{}\")",
+                               arg1),
+                   ErrorType::Input);
+      } else if (cmd == "RUN" && text == nullptr) {
+        WriteError(
+            err,
+            std::format("ケースが読み込まれていません。 (ケース ID: \"{}\")",
+                        arg2),
+            ErrorType::Input);
+      } else if (inlineTcl || text != nullptr) {
+        if (script == nullptr) {
+          // TCL を読み取る（ケースの TCL は次からそのまま使う）
+          std::istringstream in{inlineTcl ? inlineTcl.value() : *text};
+          std::ostringstream errors;
+          auto compiled = std::make_shared<CompiledScript>(CompiledScript{
+              .program = program,
+              .text = text,
+              .events = ReadInput(in, errors, program->nameTable),
+              .errors = {}});
+          compiled->errors = errors.str();
+          script = std::move(compiled);
+          if (cmd == "RUN") {
+            const std::lock_guard<std::mutex> lock{registry.mutex};
+            registry.scripts[arg1 + ' ' + arg2] = script;
+          }
+        }
+        if (not script->events) {
+          err << script->errors;
+        } else {
+          auto &[pooled, pool] = pools[arg1];
+          if (pooled != program) {
+            pooled = program;
+            pool = std::make_unique<TeCPool>(*program->image);
+          }
+          std::unique_ptr<TeC> tec = pool->acquire();
+          code = RunEvents(*program, options, *tec, script->events.value(),
+                           out, err);
+          pool->release(std::move(tec));
+        }
+      }
+    } else {
+      WriteError(err,
+                 std::format("不正な要求です。 (要求: \"{}\")", line.value()),
+                 ErrorType::Input);
+    }
+    out.flush();
+    err.flush();
+    connected = SendAll(fd, std::format("EXIT {}\n", code)) && out && err;
+  }
+  ::close(fd);
+}
+
+/// @brief 常駐して、ソケットで実行の要求を受け付ける（--serve）。
+/// @param path ソケットのパス（既にあれば置き換える）
+/// @param options 実行の設定
+/// @param aot tec2c で C++ に変換したプログラム（なければ nullptr）
+/// @note 接続ごとにスレッドを作り、終了しない。
+[[noreturn]] static inline void Serve(const char *path,
+                                      const RunOptions &options,
+                                      const AotInfo *aot) {
+  // 接続が切れたソケットへの書き込みで終了しないようにする
+  std::signal(SIGPIPE, SIG_IGN);
+  sockaddr_un addr{};
+  addr.sun_family = AF_UNIX;
+  if (sizeof(addr.sun_path) <= std::strlen(path)) {
+    Error(std::format("ソケットのパスが長すぎます。 (パス: \"{}\")", path),
+          ErrorType::Input);
+  }
+  std::strcpy(addr.sun_path, path);
+  std::error_code ec;
+  if (std::filesystem::is_socket(path, ec)) {
+    std::filesystem::remove(path, ec);
+  }
+  const int listenFd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listenFd < 0 ||
+      ::bind(listenFd, reinterpret_cast<const sockaddr *>(&addr),
+             sizeof(addr)) != 0 ||
+      ::listen(listenFd, SOMAXCONN) != 0) {
+    Error(std::format("ソケットが開けませんでした。 (パス: \"{}\")", path),
+          ErrorType::Input);
+  }
+  ServeRegistry registry{};
+  for (;;) {
+    const int fd = ::accept(listenFd, nullptr, nullptr);
+    if (fd < 0) {
+      if (errno == EINTR || errno == ECONNABORTED) {
+        continue;
+      }
+      Error(std::format("接続を受け付けられませんでした。 (パス: \"{}\")",
+                        path),
+            ErrorType::Input);
+    }
+    std::thread{[&registry, &options, aot, fd]() -> void {
+      ServeConnection(registry, options, aot, fd);
+    }}.detach();
+  }
+}
+#endif
+
+/// @brief シミュレータを実行する（tec と、tec2c が生成したシミュレータの main()）。
+/// @param argc コマンドライン引数の数
+/// @param argv コマンドライン引数
+/// @param aot tec2c で C++ に変換したプログラム（なければ nullptr）
+/// @return 終了コード
+static inline int Main(const int argc, char const *argv[],
+                       const AotInfo *aot = nullptr) {
+  // オプションとそれ以外の引数を分ける
+  RunOptions options{.engine = aot != nullptr ? Engine::Aot : Engine::Tiered,
+                     .maxStates = UINT64_MAX,
+                     .timeoutMs = std::nullopt,
+                     .printStats = false};
+  std::vector<const char *> args;
+  // --cases 以降の引数（ケースの入力ファイルまたはディレクトリ）
+  std::vector<const char *> cases;
+  bool hasCases = false;
+  unsigned int jobs = std::max(1U, std::thread::hardware_concurrency());
+  bool combined = false;
+  // --serve のソケットのパス
+  const char *servePath = nullptr;
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    if (arg.starts_with("--engine=")) {
+      if (const std::optional<Engine> e =
+              StrToEngine(arg.substr(std::string("--engine=").size()))) {
+        options.engine = e.value();
+      } else {
+        Usage(argv[0]);
+      }
+    } else if (arg.starts_with("--max-states=")) {
+      if (const std::optional<uint64_t> n = StrToUInt64(
+              arg.substr(std::string("--max-states=").size()))) {
+        options.maxStates = n.value();
+      } else {
+        Usage(argv[0]);
+      }
+    } else if (arg.starts_with("--timeout-ms=")) {
+      if (const std::optional<uint64_t> n = StrToUInt64(
+              arg.substr(std::string("--timeout-ms=").size()))) {
+        options.timeoutMs = n;
+      } else {
+        Usage(argv[0]);
+      }
+    } else if (arg == "--stats") {
+      options.printStats = true;
+    } else if (arg.starts_with("--jobs=")) {
+      const std::optional<uint64_t> n =
+          StrToUInt64(arg.substr(std::string("--jobs=").size()));
+      if (not n || n.value() == 0 || UINT16_MAX < n.value()) {
+        Usage(argv[0]);
+      }
+      jobs = static_cast<unsigned int>(n.value());
+    } else if (arg == "--combined") {
+      combined = true;
+    } else if (arg == "--cases") {
+      hasCases = true;
+#if TEC_SERVE
+    } else if (arg == "--serve" && i + 1 < argc) {
+      servePath = argv[++i];
+#endif
+    } else if (arg.starts_with("--")) {
+      Usage(argv[0]);
+    } else if (hasCases) {
+      cases.emplace_back(argv[i]);
+    } else {
+      args.emplace_back(argv[i]);
+    }
+  }
+#if TEC_SERVE
+  if (servePath != nullptr) {
+    if (not args.empty() || hasCases) {
+      Usage(argv[0]);
+    }
+    Serve(servePath, options, aot);
+  }
+#endif
+  if (args.size() < 1 || 2 < args.size() || (hasCases && cases.empty()) ||
+      (combined && not hasCases)) {
+    Usage(argv[0]);
+  }
+  const std::optional<Program> loaded = LoadProgram(
+      args[0], args.size() == 2 ? args[1] : nullptr, aot, std::cerr);
+  if (not loaded) {
+    return 1;
+  }
+  const Program &program = loaded.value();
+  if (hasCases) {
+    return RunCases(program, options, ExpandCases(cases), jobs, combined);
+  }
+  TeCPool pool{*program.image};
+  std::unique_ptr<TeC> tec = pool.acquire();
+  return RunCase(program, options, *tec, std::cin, std::cout, std::cerr);
+}
@@ -0,0 +1,298 @@
+#include "tec.hpp"
+
+#include <sstream>
+
+/// @brief 使用方法を出力して終了する。
+/// @param cmd 自分自身の名前
+[[noreturn]] static void Tec2cUsage(const char *cmd) {
+  std::cerr << std::format("使用方法: {} <program>.bin [<program>.nt]\n", cmd);
+  std::exit(1);
+}
+
+/// @brief 変換する命令
+struct AotInst {
+  /// @brief 第1バイト
+  uint8_t inst;
+  /// @brief 第2バイト
+  uint8_t operand;
+  /// @brief 次の命令の番地
+  uint8_t next;
+};
+
+/// @brief 命令が主記憶に書き込むか
+/// @param inst 命令の第1バイト
+/// @return ST, CALL, PUSH なら true
+static constexpr bool WritesMem(const uint8_t inst) noexcept {
+  const uint8_t op = static_cast<uint8_t>((inst >> 4) & 0x0F);
+  const uint8_t gr = static_cast<uint8_t>((inst >> 2) & 0x03);
+  const uint8_t xr = static_cast<uint8_t>(inst & 0x03);
+  return (op == 0x2 && xr != 0b11) ||             // ST
+         (op == 0xB && gr == 0b00 && xr != 0b11) || // CALL
+         (op == 0xD && xr == 0b00);                 // PUSH
+}
+
+/// @brief 実行される可能性のある番地を求める。
+/// @param tec プログラムを書き込んだ TeC
+/// @param source 機械語
+/// @return 番地ごとの、命令の先頭として実行される可能性があるか
+/// @note
+/// 機械語の先頭、ROM のルーチンの入口、機械語に含まれる割り込みベクタの
+/// 指す番地から、次の命令と直接指定の分岐先をたどる。
+/// 間接的な分岐先（インデクスドモード、RET、RETI）はたどらない
+/// （実行時に変換していない番地に来れば、インタプリタで実行する）。
+static inline std::array<bool, 256> FindReachable(const TeC &tec,
+                                                  const Source &source) {
+  std::array<bool, 256> reachable{};
+  std::vector<uint8_t> work;
+  if (source.size != 0) {
+    work.push_back(source.start);
+  }
+  work.push_back(TeC::RomStartAddr);
+  work.push_back(TeC::RomReadAddr);
+  for (uint8_t vec = 0xDC; vec <= 0xDF; ++vec) {
+    if (static_cast<uint8_t>(vec - source.start) < source.size) {
+      work.push_back(tec.getMM(vec));
+    }
+  }
+  while (not work.empty()) {
+    const uint8_t pc = work.back();
+    work.pop_back();
+    if (reachable[pc]) {
+      continue;
+    }
+    reachable[pc] = true;
+    const uint8_t inst = tec.getMM(pc);
+    const uint8_t operand = tec.getMM(static_cast<uint8_t>(pc + 1));
+    const uint8_t next = static_cast<uint8_t>(pc + TeC::InstSize(inst));
+    const uint8_t op = static_cast<uint8_t>((inst >> 4) & 0x0F);
+    const uint8_t gr = static_cast<uint8_t>((inst >> 2) & 0x03);
+    const uint8_t xr = static_cast<uint8_t>(inst & 0x03);
+    if (TeC::InstStates(inst, operand) == 0) { // HALT, 不正な命令
+      continue;
+    }
+    if (op == 0xA || op == 0xB) { // Jump, CALL
+      if (xr == 0b00) {
+        work.push_back(operand);
+      }
+      if (op == 0xB || gr != 0b00) { // CALL の戻り先、条件分岐
+        work.push_back(next);
+      }
+    } else if (inst != 0xEC && inst != 0xEF) { // RET, RETI 以外
+      work.push_back(next);
+    }
+  }
+  return reachable;
+}
+
+/// @brief 番地のラベル名を求める。
+/// @param pc 番地
+/// @return ラベル名
+static inline std::string LabelOf(const uint8_t pc) {
+  return std::format("L{:02X}", pc);
+}
+
+/// @brief 1命令を C++ に変換する。
+/// @param out 出力先
+/// @param pc 命令の番地
+/// @param inst 命令
+/// @param reachable 番地ごとの、実行される可能性があるか
+/// @param fallsThrough 次に出力する命令の番地が pc の次の命令か
+static inline void EmitInst(std::ostream &out, const uint8_t pc,
+                            const AotInst &inst,
+                            const std::array<bool, 256> &reachable,
+                            const bool fallsThrough) {
+  const uint8_t op = static_cast<uint8_t>((inst.inst >> 4) & 0x0F);
+  const uint8_t gr = static_cast<uint8_t>((inst.inst >> 2) & 0x03);
+  const uint8_t xr = static_cast<uint8_t>(inst.inst & 0x03);
+  if (pc == TeC::RomReadAddr) {
+    // ROM の READ ルーチンはまとめて実行する
+    out << "    states += tec.runRomRead(states);\n"
+        << "    if (tec.m_ctrl.horizon <= states) {\n"
+        << "      goto boundary;\n"
+        << "    }\n"
+        << "    goto dispatch;\n";
+    return;
+  }
+  out << std::format("    states += tec.stepConst<0x{:02X}, 0x{:02X}, "
+                     "0x{:02X}>();\n",
+                     inst.inst, inst.operand, inst.next);
+  if (TeC::InstStates(inst.inst, inst.operand) == 0) {
+    // 停止した
+    out << "    goto boundary;\n";
+    return;
+  }
+  out << "    if (tec.m_ctrl.horizon <= states) {\n"
+      << "      goto boundary;\n"
+      << "    }\n";
+  if (WritesMem(inst.inst)) {
+    // 変換した命令を書き換えていないか確かめる
+    out << "    if (tec.m_ctrl.aotModified) {\n"
+        << "      goto dispatch;\n"
+        << "    }\n";
+  }
+  auto jumpTo = [&](const uint8_t addr) -> std::string {
+    return reachable[addr] ? std::format("goto {};", LabelOf(addr))
+                           : std::string("goto dispatch;");
+  };
+  if ((op == 0xA || op == 0xB) && xr == 0b00) { // 直接指定の Jump, CALL
+    if (gr == 0b00) { // JMP, CALL
+      out << std::format("    {}\n", jumpTo(inst.operand));
+      return;
+    }
+    // 条件分岐
+    out << std::format(
+        "    if (tec.m_state.pc == 0x{:02X}) {{\n      {}\n    }}\n",
+        inst.operand, jumpTo(inst.operand));
+  } else if (op == 0xA || op == 0xB || inst.inst == 0xEC ||
+             inst.inst == 0xEF) { // 間接的な分岐、RET、RETI
+    out << "    goto dispatch;\n";
+    return;
+  }
+  if (not fallsThrough) {
+    out << std::format("    {}\n", jumpTo(inst.next));
+  }
+}
+
+/// @brief 機械語を、そのプログラム専用のシミュレータの C++ ソースに変換する。
+/// @param out 出力先
+/// @param path 機械語ファイルのパス
+/// @param source 機械語
+/// @param nameTable 名前表
+static inline void Translate(std::ostream &out, const std::string &path,
+                             const Source &source,
+                             const NameTable &nameTable) {
+  TeC tec{};
+  tec.writeProg(source.start, source.size, source.values);
+  const std::array<bool, 256> reachable = FindReachable(tec, source);
+  // 番地ごとのラベル名
+  std::array<std::vector<std::string>, 256> names{};
+  for (const auto &[name, addr] : nameTable) {
+    names[addr].push_back(name);
+  }
+  for (std::vector<std::string> &v : names) {
+    std::sort(v.begin(), v.end());
+  }
+  // 命令として変換する番地（ROM 領域を除く）
+  std::array<bool, 256> cover{};
+  for (size_t pc = 0; pc < reachable.size(); ++pc) {
+    if (reachable[pc] && pc < TeC::RomStartAddr) {
+      const uint8_t size = TeC::InstSize(tec.getMM(static_cast<uint8_t>(pc)));
+      for (uint8_t i = 0; i < size; ++i) {
+        cover[static_cast<uint8_t>(pc + i)] = true;
+      }
+    }
+  }
+  out << std::format("// tec2c で \"{}\" から生成したシミュレータ\n", path)
+      << "// 生成したファイルは編集しないこと\n"
+      << "#include \"tec.hpp\"\n"
+      << "\n"
+      << "/// @brief 変換した機械語\n"
+      << std::format("static constexpr std::array<uint8_t, {}> Values = {{",
+                     source.size);
+  for (size_t i = 0; i < source.size; ++i) {
+    out << (i % 8 == 0 ? "\n    " : " ")
+        << std::format("0x{:02X},", source.values[i]);
+  }
+  out << "\n};\n"
+      << "\n"
+      << "/// @brief 変換したプログラム\n"
+      << "struct AotProgram {\n"
+      << "  /// @brief 指定したステート数の命令を実行する（TeC::clock() を参照）。\n"
+      << "  static uint64_t clock(TeC &tec, const uint64_t maxStates) {\n"
+      << "    uint64_t states = 0;\n"
+      << "    tec.beginHorizon(states, maxStates);\n"
+      << "  dispatch:\n"
+      << "    if (tec.m_ctrl.aotModified) {\n"
+      << "      return tec.resumeInterp(states, maxStates);\n"
+      << "    }\n"
+      << "    switch (tec.m_state.pc) {\n";
+  for (size_t pc = 0; pc < reachable.size(); ++pc) {
+    if (reachable[pc]) {
+      out << std::format("    case 0x{:02X}:\n      goto {};\n", pc,
+                         LabelOf(static_cast<uint8_t>(pc)));
+    }
+  }
+  out << "    default:\n"
+      << "      break;\n"
+      << "    }\n"
+      << "    // 変換していない番地の命令はインタプリタで実行する\n"
+      << "    states += tec.stepInterp(states);\n"
+      << "    if (states < tec.m_ctrl.horizon) {\n"
+      << "      goto dispatch;\n"
+      << "    }\n"
+      << "  boundary:\n"
+      << "    if (tec.isClockDone(states, maxStates)) {\n"
+      << "      return states;\n"
+      << "    }\n"
+      << "    tec.beginHorizon(states, maxStates);\n"
+      << "    goto dispatch;\n";
+  // 変換する命令を番地順に出力する
+  std::vector<uint8_t> pcs;
+  for (size_t pc = 0; pc < reachable.size(); ++pc) {
+    if (reachable[pc]) {
+      pcs.push_back(static_cast<uint8_t>(pc));
+    }
+  }
+  for (size_t i = 0; i < pcs.size(); ++i) {
+    const uint8_t pc = pcs[i];
+    const AotInst inst{
+        .inst = tec.getMM(pc),
+        .operand = tec.getMM(static_cast<uint8_t>(pc + 1)),
+        .next = static_cast<uint8_t>(pc + TeC::InstSize(tec.getMM(pc)))};
+    std::string comment = std::format("{:02X}", inst.inst);
+    if (TeC::InstSize(inst.inst) == 2) {
+      comment += std::format(" {:02X}", inst.operand);
+    }
+    for (const std::string &name : names[pc]) {
+      comment += " " + name;
+    }
+    out << std::format("  {}: // {}\n", LabelOf(pc), comment);
+    EmitInst(out, pc, inst, reachable,
+             i + 1 < pcs.size() && pcs[i + 1] == inst.next);
+  }
+  out << "  }\n"
+      << "};\n"
+      << "\n"
+      << "int main(int argc, char const *argv[]) {\n"
+      << "  static const AotInfo Info = {\n"
+      << "      .clock = &AotProgram::clock,\n"
+      << std::format("      .start = 0x{:02X},\n", source.start)
+      << std::format("      .size = {},\n", source.size)
+      << "      .values = Values.data(),\n"
+      << "      .cover = {";
+  for (size_t i = 0; i < cover.size(); ++i) {
+    out << (i % 16 == 0 ? "\n          " : " ") << (cover[i] ? "1," : "0,");
+  }
+  out << "\n      }};\n"
+      << "  return Main(argc, argv, &Info);\n"
+      << "}\n";
+}
+
+int main(int argc, char const *argv[]) {
+  if (argc < 2 || 3 < argc) {
+    Tec2cUsage(argv[0]);
+  }
+  // プログラム名
+  std::string progname = argv[1];
+  // 拡張子の確認
+  if (progname.ends_with(".bin")) {
+    // プログラム名から拡張子を除去
+    progname.erase(progname.end() - 4, progname.end());
+  } else {
+    Error("拡張子は、\"bin\" である必要があります。", ErrorType::Binary);
+  }
+  const Source source = readSource(argv[1]);
+  NameTable nameTable = {};
+  if (argc == 3) {
+    nameTable = ReadNameTable(argv[2]);
+  }
+  std::ostringstream out;
+  Translate(out, argv[1], source, nameTable);
+  const std::string path = progname + ".cpp";
+  std::ofstream ofs{path};
+  if (not(ofs << out.str())) {
+    Error(std::format("ファイルに書き込めませんでした。 (パス: \"{}\")", path),
+          ErrorType::Binary);
+  }
+  return 0;
+}
@@ -0,0 +1,596 @@
+#include "tec.hpp"
+
+#include <mutex>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+/// @brief 使用方法を出力して終了する。
+/// @param cmd 自分自身の名前
+[[noreturn]] static void JudgeUsage(const char *cmd) {
+  std::cerr << std::format(
+      "使用方法: {} [--engine=(interp|threaded|block|jit|tiered)] "
+      "[--max-states=<ステート数>] [--timeout-ms=<ミリ秒数>] "
+      "[--jobs=<並列数>] [--affinity] [--cache=<ディレクトリ>] "
+      "--programs <program>.bin ... --cases (<case>.in|<dir>) ...\n",
+      cmd);
+  std::exit(1);
+}
+
+/// @brief 採点の結果
+enum class Verdict : uint8_t {
+  /// @brief 期待する出力と一致した
+  AC,
+  /// @brief 期待する出力と一致しなかった
+  WA,
+  /// @brief エラーで終了した
+  RE,
+  /// @brief 実行の制限に達した
+  TLE,
+  /// @brief 正常に終了した（期待する出力がない）
+  OK
+};
+
+static constexpr const char *VerdictToStr(const Verdict verdict) noexcept {
+  switch (verdict) {
+  case Verdict::AC:
+    return "AC";
+  case Verdict::WA:
+    return "WA";
+  case Verdict::RE:
+    return "RE";
+  case Verdict::TLE:
+    return "TLE";
+  case Verdict::OK:
+    return "OK";
+  }
+  return "??";
+}
+
+/// @brief 採点する（プログラム, ケース）の組
+struct Job {
+  /// @brief プログラムの添字
+  size_t program;
+  /// @brief ケースの添字
+  size_t testCase;
+};
+
+/// @brief ワーカーごとのジョブの両端キュー
+/// @note
+/// 持ち主は先頭から取り出し、他のワーカーは末尾から盗む。
+/// 持ち主は同じプログラムのジョブを続けて実行するので TeC の置き場が効き、
+/// 盗む側は持ち主が最後に実行するはずだったジョブを持っていく。
+class JobDeque {
+public:
+  JobDeque() : m_mutex(), m_jobs() {}
+
+  /// @brief 末尾にジョブを追加する。
+  /// @param job ジョブ
+  void push(const Job job) {
+    const std::lock_guard<std::mutex> lock{m_mutex};
+    m_jobs.push_back(job);
+  }
+
+  /// @brief 先頭からジョブを取り出す（持ち主用）。
+  /// @return ジョブ（なければ std::nullopt）
+  std::optional<Job> pop() {
+    const std::lock_guard<std::mutex> lock{m_mutex};
+    if (m_jobs.empty()) {
+      return std::nullopt;
+    }
+    const Job job = m_jobs.front();
+    m_jobs.pop_front();
+    return job;
+  }
+
+  /// @brief 末尾からジョブを盗む（他のワーカー用）。
+  /// @return ジョブ（なければ std::nullopt）
+  std::optional<Job> steal() {
+    const std::lock_guard<std::mutex> lock{m_mutex};
+    if (m_jobs.empty()) {
+      return std::nullopt;
+    }
+    const Job job = m_jobs.back();
+    m_jobs.pop_back();
+    return job;
+  }
+
+private:
+  std::mutex m_mutex;
+  std::deque<Job> m_jobs;
+};
+
+/// @brief ワーカーを固定できる CPU を求める（Linux 以外では空）。
+/// @return CPU の番号
+static std::vector<int> AllowedCpus() {
+  std::vector<int> cpus;
+#if defined(__linux__)
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+      if (CPU_ISSET(cpu, &set)) {
+        cpus.emplace_back(cpu);
+      }
+    }
+  }
+#endif
+  return cpus;
+}
+
+/// @brief 呼び出したスレッドを CPU に固定する（Linux 以外では何もしない）。
+/// @param cpu CPU の番号
+static void PinToCpu([[maybe_unused]] const int cpu) {
+#if defined(__linux__)
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#endif
+}
+
+/// @brief ケースの入力ファイルのパスから期待する出力のファイルのパスを求める。
+/// @param path 入力ファイルのパス（<case>.in）
+/// @return 期待する出力のファイルのパス（<case>.out）
+static std::string OutPath(std::string path) {
+  if (path.ends_with(".in")) {
+    path.erase(path.end() - 3, path.end());
+  }
+  return path + ".out";
+}
+
+/// @brief ファイルの内容を読む。
+/// @param path ファイルのパス
+/// @return ファイルの内容（開けなければ std::nullopt）
+static std::optional<std::string> ReadFile(const std::string &path) {
+  std::ifstream ifs{path, std::ios_base::binary};
+  if (not ifs) {
+    return std::nullopt;
+  }
+  std::ostringstream ss;
+  ss << ifs.rdbuf();
+  return ss.str();
+}
+
+/// @brief 整数をリトルエンディアンで追加する。
+/// @param buf 追加先
+/// @param val 整数
+/// @param bytes バイト数
+static void PutN(std::string &buf, const uint64_t val, const size_t bytes) {
+  for (size_t i = 0; i < bytes; ++i) {
+    buf += static_cast<char>(val >> (8 * i));
+  }
+}
+
+/// @brief バイト列を長さ（8バイト）に続けて追加する。
+/// @param buf 追加先
+/// @param bytes バイト列
+static void PutBytes(std::string &buf, const std::string_view bytes) {
+  PutN(buf, bytes.size(), 8);
+  buf += bytes;
+}
+
+/// @brief キャッシュのファイル名に使うハッシュ値を求める（FNV-1a）。
+/// @param bytes バイト列
+/// @return ハッシュ値
+static uint64_t Fnv1a(const std::string_view bytes) noexcept {
+  uint64_t hash = 0xCBF29CE484222325;
+  for (const char ch : bytes) {
+    hash = (hash ^ static_cast<uint8_t>(ch)) * 0x100000001B3;
+  }
+  return hash;
+}
+
+/// @brief キャッシュした実行結果
+struct CachedResult {
+  /// @brief 終了コード
+  int exitCode;
+  /// @brief 出力
+  std::string out;
+  /// @brief エラーメッセージと統計
+  std::string err;
+  /// @brief 実行にかかった時間（ミリ秒）
+  uint64_t ms;
+};
+
+/// @brief ディスク上の実行結果のキャッシュ（--cache）
+/// @note
+/// キーは（シミュレータの版, ステート数の上限, 機械語, 名前表, TCL）を
+/// 並べたバイト列で、そのハッシュ値をファイル名にする。ファイルには
+/// キー全体も書き込み、読み込むときに一致を確かめるので、ハッシュ値が
+/// 衝突しても別のプログラムの結果を返すことはない。
+/// 実行方式はどれも同じ結果になるので、キーに含めない。
+class ResultCache {
+public:
+  /// @param dir キャッシュのディレクトリ（作成済み）
+  explicit ResultCache(std::filesystem::path dir) : m_dir(std::move(dir)) {}
+
+  /// @brief キーを求める。
+  /// @param program 機械語と名前表（ProgramKey() を参照）
+  /// @param input TCL
+  /// @param options 実行の設定
+  /// @return キー
+  static std::string key(const std::string_view program,
+                         const std::string_view input,
+                         const RunOptions &options) {
+    std::string key;
+    PutN(key, SimulatorVersion, 4);
+    PutN(key, options.maxStates, 8);
+    key += program;
+    PutBytes(key, input);
+    return key;
+  }
+
+  /// @brief キャッシュした結果を探す。
+  /// @param key キー
+  /// @return 結果（なければ std::nullopt）
+  std::optional<CachedResult> find(const std::string &key) const {
+    const std::optional<std::string> entry = ReadFile(path(key).string());
+    if (not entry || not entry->starts_with(Magic) ||
+        entry->compare(Magic.size(), key.size(), key) != 0) {
+      return std::nullopt;
+    }
+    std::string_view rest{*entry};
+    rest.remove_prefix(Magic.size() + key.size());
+    bool ok = true;
+    auto getN = [&](const size_t bytes) -> uint64_t {
+      if (rest.size() < bytes) {
+        ok = false;
+        return 0;
+      }
+      uint64_t val = 0;
+      for (size_t i = 0; i < bytes; ++i) {
+        val |= static_cast<uint64_t>(static_cast<uint8_t>(rest[i])) << (8 * i);
+      }
+      rest.remove_prefix(bytes);
+      return val;
+    };
+    auto getBytes = [&]() -> std::string {
+      const uint64_t size = getN(8);
+      if (not ok || rest.size() < size) {
+        ok = false;
+        return {};
+      }
+      std::string bytes{rest.substr(0, size)};
+      rest.remove_prefix(size);
+      return bytes;
+    };
+    CachedResult result{};
+    result.exitCode = static_cast<int>(static_cast<int32_t>(getN(4)));
+    result.ms = getN(8);
+    result.out = getBytes();
+    result.err = getBytes();
+    if (not ok || not rest.empty()) {
+      return std::nullopt;
+    }
+    return result;
+  }
+
+  /// @brief 結果をキャッシュに書き込む（書き込めなければ何もしない）。
+  /// @param key キー
+  /// @param result 結果
+  void store(const std::string &key, const CachedResult &result) const {
+    std::string entry{Magic};
+    entry += key;
+    PutN(entry, static_cast<uint32_t>(result.exitCode), 4);
+    PutN(entry, result.ms, 8);
+    PutBytes(entry, result.out);
+    PutBytes(entry, result.err);
+    // 書き込み途中のファイルを読まないよう、一時ファイルから置き換える
+    const std::filesystem::path dst = path(key);
+    std::filesystem::path tmp = dst;
+    tmp += std::format(
+        ".{:x}.{:x}.tmp",
+        std::hash<std::thread::id>{}(std::this_thread::get_id()),
+        std::chrono::steady_clock::now().time_since_epoch().count());
+    {
+      std::ofstream ofs{tmp, std::ios_base::binary};
+      ofs.write(entry.data(), static_cast<std::streamsize>(entry.size()));
+      if (not ofs) {
+        ofs.close();
+        std::error_code ec;
+        std::filesystem::remove(tmp, ec);
+        return;
+      }
+    }
+    std::error_code ec;
+    std::filesystem::rename(tmp, dst, ec);
+    if (ec) {
+      std::filesystem::remove(tmp, ec);
+    }
+  }
+
+private:
+  /// @brief ファイルの先頭
+  static constexpr std::string_view Magic{"TECCACHE", 8};
+
+  std::filesystem::path m_dir;
+
+  std::filesystem::path path(const std::string &key) const {
+    return m_dir / std::format("{:016x}", Fnv1a(key));
+  }
+};
+
+/// @brief プログラムを同じ内容かどうかで比べるためのキーを求める。
+/// @param bin 機械語ファイルの内容
+/// @param nt 名前表ファイルの内容（なければ空）
+/// @return キー
+static std::string ProgramKey(const std::string_view bin,
+                              const std::string_view nt) {
+  std::string key;
+  PutBytes(key, bin);
+  PutBytes(key, nt);
+  return key;
+}
+
+/// @brief 複数のプログラムを複数のケースで採点する。
+/// @note
+/// （プログラム, ケース）の組をワーカーごとの両端キューに分けて置き、
+/// 自分のキューが空になったワーカーは他のワーカーのキューから盗む。
+/// 結果は終わった順に1行ずつ標準出力に出力する
+/// （"<結果> <program>.bin <case>.in <ミリ秒数>ms"）。
+/// @note
+/// 内容が同じプログラム（機械語と名前表）は1つだけ実行し、同じ結果を
+/// それぞれのパスで出力する。--cache を指定すると、実行結果をディスクに
+/// キャッシュし、同じプログラムとケースの採点はキャッシュから答える
+/// （行の末尾に " (cache)" を付ける）。期待する出力はキーに含めないので、
+/// 期待する出力を直した再採点もキャッシュから答えられる。
+int main(int argc, char const *argv[]) {
+  RunOptions options{.engine = Engine::Tiered,
+                     .maxStates = UINT64_MAX,
+                     .timeoutMs = std::nullopt,
+                     .printStats = false};
+  unsigned int jobs = std::max(1U, std::thread::hardware_concurrency());
+  bool affinity = false;
+  std::optional<std::string> cacheDir;
+  std::vector<const char *> binPaths;
+  std::vector<const char *> caseArgs;
+  // 位置引数の種類（--programs, --cases で切り替える）
+  std::vector<const char *> *positional = nullptr;
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    if (arg.starts_with("--engine=")) {
+      const std::optional<Engine> e =
+          StrToEngine(arg.substr(std::string("--engine=").size()));
+      if (not e || e.value() == Engine::Aot) {
+        JudgeUsage(argv[0]);
+      }
+      options.engine = e.value();
+    } else if (arg.starts_with("--max-states=")) {
+      if (const std::optional<uint64_t> n = StrToUInt64(
+              arg.substr(std::string("--max-states=").size()))) {
+        options.maxStates = n.value();
+      } else {
+        JudgeUsage(argv[0]);
+      }
+    } else if (arg.starts_with("--timeout-ms=")) {
+      if (const std::optional<uint64_t> n = StrToUInt64(
+              arg.substr(std::string("--timeout-ms=").size()))) {
+        options.timeoutMs = n;
+      } else {
+        JudgeUsage(argv[0]);
+      }
+    } else if (arg.starts_with("--jobs=")) {
+      const std::optional<uint64_t> n =
+          StrToUInt64(arg.substr(std::string("--jobs=").size()));
+      if (not n || n.value() == 0 || UINT16_MAX < n.value()) {
+        JudgeUsage(argv[0]);
+      }
+      jobs = static_cast<unsigned int>(n.value());
+    } else if (arg == "--affinity") {
+      affinity = true;
+    } else if (arg.starts_with("--cache=")) {
+      cacheDir = arg.substr(std::string("--cache=").size());
+      if (cacheDir->empty()) {
+        JudgeUsage(argv[0]);
+      }
+    } else if (arg == "--programs") {
+      positional = &binPaths;
+    } else if (arg == "--cases") {
+      positional = &caseArgs;
+    } else if (arg.starts_with("--") || positional == nullptr) {
+      JudgeUsage(argv[0]);
+    } else {
+      positional->emplace_back(argv[i]);
+    }
+  }
+  if (binPaths.empty() || caseArgs.empty()) {
+    JudgeUsage(argv[0]);
+  }
+  std::optional<ResultCache> cache;
+  if (cacheDir) {
+    std::error_code ec;
+    std::filesystem::create_directories(cacheDir.value(), ec);
+    if (ec) {
+      WriteError(std::cerr,
+                 std::format("キャッシュのディレクトリが作れませんでした。 "
+                             "(パス: \"{}\")",
+                             cacheDir.value()),
+                 ErrorType::Input);
+      return 1;
+    }
+    cache.emplace(cacheDir.value());
+  }
+  int exitCode = 0;
+  // プログラム（名前表は <program>.nt があれば読む）
+  std::vector<Program> programs;
+  // プログラムの内容のキー（ProgramKey() を参照）
+  std::vector<std::string> programKeys;
+  // 同じ内容のプログラムのパスの添字（最初のものにまとめる）
+  std::vector<std::vector<size_t>> aliases(binPaths.size());
+  std::unordered_map<std::string, size_t> programIndex;
+  std::vector<size_t> loaded;
+  for (size_t i = 0; i < binPaths.size(); ++i) {
+    const char *path = binPaths[i];
+    std::string ntPath = path;
+    if (ntPath.ends_with(".bin")) {
+      ntPath.erase(ntPath.end() - 4, ntPath.end());
+    }
+    ntPath += ".nt";
+    const bool hasNt = std::filesystem::exists(ntPath);
+    const std::optional<std::string> bin = ReadFile(path);
+    const std::optional<std::string> nt =
+        hasNt ? ReadFile(ntPath) : std::optional<std::string>{""};
+    std::string key = bin && nt ? ProgramKey(bin.value(), nt.value()) : "";
+    if (const auto it = programIndex.find(key); it != programIndex.end()) {
+      aliases[it->second].emplace_back(i);
+      // 添字を binPaths と揃えるため、空のプログラムを置く
+      programs.emplace_back(Program{
+          .source = {}, .nameTable = {}, .aot = nullptr, .image = nullptr});
+      programKeys.emplace_back();
+      continue;
+    }
+    std::ostringstream err;
+    std::optional<Program> program =
+        LoadProgram(path, hasNt ? ntPath.c_str() : nullptr, nullptr, err);
+    if (program) {
+      loaded.emplace_back(programs.size());
+      programs.emplace_back(std::move(program).value());
+      aliases[i].emplace_back(i);
+      if (bin && nt) {
+        programIndex.emplace(key, i);
+      }
+    } else {
+      std::cerr << std::format("{}:\n", path) << err.str();
+      exitCode = 1;
+      programs.emplace_back(Program{
+          .source = {}, .nameTable = {}, .aot = nullptr, .image = nullptr});
+    }
+    programKeys.emplace_back(std::move(key));
+  }
+  // ケース（入力と期待する出力は最初に全て読む）
+  const std::vector<std::string> cases = ExpandCases(caseArgs);
+  std::vector<std::string> inputs;
+  std::vector<std::optional<std::string>> expected;
+  for (const std::string &path : cases) {
+    std::optional<std::string> input = ReadFile(path);
+    if (not input) {
+      std::cerr << std::format("{}:\n", path);
+      WriteError(std::cerr,
+                 std::format("ファイルが開けませんでした。 (パス: \"{}\")",
+                             path),
+                 ErrorType::Input);
+      return 1;
+    }
+    inputs.emplace_back(std::move(input).value());
+    expected.emplace_back(ReadFile(OutPath(path)));
+  }
+  // ジョブをプログラムごとに並べ、連続した範囲ずつワーカーに分ける
+  const size_t total = loaded.size() * cases.size();
+  const size_t workers = std::max<size_t>(1, std::min<size_t>(jobs, total));
+  std::vector<JobDeque> deques(workers);
+  for (size_t i = 0; i < total; ++i) {
+    deques[i * workers / std::max<size_t>(1, total)].push(
+        Job{.program = loaded[i / cases.size()],
+            .testCase = i % cases.size()});
+  }
+  const std::vector<int> cpus = affinity ? AllowedCpus() : std::vector<int>{};
+  std::mutex outMutex;
+  std::atomic<bool> failed = false;
+  auto worker = [&](const size_t id) -> void {
+    if (not cpus.empty()) {
+      PinToCpu(cpus[id % cpus.size()]);
+    }
+    // プログラムごとの TeC の置き場（最初に使うときに作る）
+    std::vector<std::unique_ptr<TeCPool>> pools(programs.size());
+    // キャッシュせずに実行する
+    // （キャッシュできない結果なら cacheable を false にする）
+    auto run = [&](const Job job, bool &cacheable) -> CachedResult {
+      const Program &program = programs[job.program];
+      if (pools[job.program] == nullptr) {
+        pools[job.program] = std::make_unique<TeCPool>(*program.image);
+      }
+      const auto begin = std::chrono::steady_clock::now();
+      std::istringstream in{inputs[job.testCase]};
+      std::ostringstream out;
+      std::ostringstream err;
+      int code = 1;
+      if (const std::optional<EventList> events =
+              ReadInput(in, err, program.nameTable)) {
+        // ケースの外のファイルを読み書きする結果はキャッシュしない
+        cacheable = std::none_of(
+            events->begin(), events->end(),
+            [](const std::unique_ptr<Event> &event) -> bool {
+              return event->type == EventType::SerialFile ||
+                     event->type == EventType::Save ||
+                     event->type == EventType::Load;
+            });
+        std::unique_ptr<TeC> tec = pools[job.program]->acquire();
+        code = RunEvents(program, options, *tec, events.value(), out, err);
+        pools[job.program]->release(std::move(tec));
+      }
+      // 実時間の上限に達したかどうかは、実行するたびに変わりうる
+      if (code == LimitExitCode && options.timeoutMs) {
+        cacheable = false;
+      }
+      const auto elapsed =
+          std::chrono::duration_cast<std::chrono::milliseconds>(
+              std::chrono::steady_clock::now() - begin);
+      return CachedResult{.exitCode = code,
+                          .out = out.str(),
+                          .err = err.str(),
+                          .ms = static_cast<uint64_t>(elapsed.count())};
+    };
+    auto runJob = [&](const Job job) -> void {
+      std::string key;
+      std::optional<CachedResult> result;
+      if (cache) {
+        key = ResultCache::key(programKeys[job.program], inputs[job.testCase],
+                               options);
+        result = cache->find(key);
+      }
+      const bool cached = result.has_value();
+      if (not cached) {
+        bool cacheable = true;
+        result = run(job, cacheable);
+        if (cache && cacheable) {
+          cache->store(key, result.value());
+        }
+      }
+      Verdict verdict = Verdict::OK;
+      if (result->exitCode == LimitExitCode) {
+        verdict = Verdict::TLE;
+      } else if (result->exitCode != 0) {
+        verdict = Verdict::RE;
+      } else if (const std::optional<std::string> &exp =
+                     expected[job.testCase]) {
+        verdict = result->out == exp.value() ? Verdict::AC : Verdict::WA;
+      }
+      if (verdict != Verdict::AC && verdict != Verdict::OK) {
+        failed = true;
+      }
+      const std::lock_guard<std::mutex> lock{outMutex};
+      for (const size_t alias : aliases[job.program]) {
+        std::cout << std::format("{} {} {} {}ms{}\n", VerdictToStr(verdict),
+                                 binPaths[alias], cases[job.testCase],
+                                 result->ms, cached ? " (cache)" : "");
+        if (not result->err.empty()) {
+          std::cerr << std::format("{} {}:\n", binPaths[alias],
+                                   cases[job.testCase])
+                    << result->err;
+        }
+      }
+      std::cout << std::flush;
+    };
+    while (const std::optional<Job> job = deques[id].pop()) {
+      runJob(job.value());
+    }
+    // 自分のキューが空になったら、隣のワーカーから順に盗む
+    for (size_t k = 1; k < workers; ++k) {
+      JobDeque &victim = deques[(id + k) % workers];
+      while (const std::optional<Job> job = victim.steal()) {
+        runJob(job.value());
+      }
+    }
+  };
+  {
+    std::vector<std::jthread> threads;
+    for (size_t id = 1; id < workers; ++id) {
+      threads.emplace_back(worker, id);
+    }
+    worker(0);
+  }
+  return failed ? 1 : exitCode;
+}
@@ -1,5 +1,8 @@
 #!/bin/sh
 set -e
+# 全ての実行方式と、tec2c で変換したシミュレータで同じ出力になることを確かめる
+# （全てのケースを1つのプロセスで実行する --cases と tecjudge でも確かめる）
+engines="interp threaded block jit tiered"
 for problem in *
 do
     if [ -d $problem ]; then
@@ -7,22 +10,104 @@ do
         do
             bin=${program%.*}.bin
             nt=${program%.*}.nt
-            rm -f $bin $nt
+            cpp=${program%.*}.cpp
+            aot=${program%.*}.aot
+            rm -f $bin $nt $cpp $aot
             ( set -x; ../../bin/tasm $program )
             [ -f $bin ]
             [ -f $nt ]
+            ( set -x; ../../bin/tec2c $bin $nt )
+            ( set -x; ${CXX:-g++} -std=c++20 -pthread -O1 -I../../src $cpp -o $aot )
             for casein in $problem/*.in
             do
                 caseout=${casein%.*}.out
                 casedst=${casein%.*}.dst
                 if [ -f $caseout ]; then
-                    ( set -x; ../../bin/tec $bin $nt < $casein > $casedst )
+                    for engine in $engines
+                    do
+                        ( set -x; ../../bin/tec --engine=$engine $bin $nt < $casein > $casedst )
+                        cmp $caseout $casedst
+                    done
+                    ( set -x; ./$aot $bin $nt < $casein > $casedst )
                     cmp $caseout $casedst
                 else
                     echo "WARNING: file \"$caseout\" doesn't exist"
                 fi
             done
+            ( set -x; ../../bin/tec $bin $nt --cases $problem )
+            for casein in $problem/*.in
+            do
+                caseout=${casein%.*}.out
+                casedst=${casein%.*}.dst
+                if [ -f $caseout ]; then
+                    cmp $caseout $casedst
+                fi
+            done
+            # 同じプログラムを2回指定すると、1回だけ実行した結果をパスごとに続けて出力する
+            rm -rf $problem/cache
+            ( set -x; ../../bin/tecjudge --cache=$problem/cache --programs $bin $bin --cases $problem > $problem/judge.dst )
+            cases=$(ls $problem/*.in | wc -l)
+            [ $(wc -l < $problem/judge.dst) -eq $((cases * 2)) ]
+            [ $(uniq $problem/judge.dst | wc -l) -eq $cases ]
+            [ $(grep -c ' (cache)$' $problem/judge.dst) -eq 0 ]
+            # 2回目は、ケースの外のファイルを使うケース以外をキャッシュから答える
+            ( set -x; ../../bin/tecjudge --cache=$problem/cache --programs $bin --cases $problem > $problem/judge.dst )
+            cached=$(grep -L -E '^[[:space:]]*\$(SERIAL-FILE|SAVE|LOAD)' $problem/*.in | wc -l)
+            [ $(grep -c ' (cache)$' $problem/judge.dst) -eq $cached ]
+            rm -rf $problem/cache $problem/judge.dst
         done    
     fi
 done
+# 同じ大きなファイルを入力するケースが分かれても、ファイルの内容を分岐ごとに
+# 読み込まない（読み込むと、仮想メモリの上限を超える）
+dir=$(mktemp -d)
+head -c 33554432 /dev/zero > $dir/big.dat
+for i in $(seq 16); do
+    printf '$SERIAL-FILE %s\n$RUN\n$WAIT MS %d\n' $dir/big.dat $i > $dir/case$i.in
+done
+( set -x; ulimit -v 262144; ../../bin/tec --jobs=1 hello/prog.bin hello/prog.nt --cases $dir )
+for i in $(seq 16); do
+    cmp hello/case1.out $dir/case$i.dst
+done
+rm -rf $dir
+# 常駐モード（--serve）の応答を確かめる（nc が UNIX ドメインソケットに対応していれば）
+if nc -h 2>&1 | grep -q -- '-U' && nc -h 2>&1 | grep -q -- '-N'; then
+    dir=$(mktemp -d)
+    ( set -x; ../../bin/tec --serve $dir/sock & echo $! > $dir/pid )
+    for i in $(seq 50); do
+        [ -S $dir/sock ] && break
+        sleep 0.1
+    done
+    tcl=hello/case1.in
+    {
+        printf 'LOAD p hello/prog.bin hello/prog.nt\nCASE c %s\nRUN p c\n' $tcl
+        printf 'TCL p %d\n' $(wc -c < $tcl)
+        cat $tcl
+        printf 'DROP CASE c\nRUN p c\nLOAD q hello/prog.bin hello/prog.nt x\n'
+        printf 'DROP PROGRAM p\nTCL p abc\nRUN p c\n'
+    } | nc -N -U $dir/sock > $dir/reply
+    kill $(cat $dir/pid)
+    # エラーメッセージの応答（改行を含むバイト数）
+    errFrame() {
+        printf 'ERR %d\n%s\nEXIT 1\n' $(($(printf '%s' "$1" | wc -c) + 1)) "$1"
+    }
+    {
+        printf 'EXIT 0\nEXIT 0\n'
+        for i in 1 2; do
+            printf 'OUT %d\n' $(wc -c < hello/case1.out)
+            cat hello/case1.out
+            printf 'EXIT 0\n'
+        done
+        printf 'EXIT 0\n'
+        errFrame '入力: ケースが読み込まれていません。 (ケース ID: "c")'
+        errFrame '入力: 不正な要求です。 (要求: "LOAD q hello/prog.bin hello/prog.nt x")'
+        printf 'EXIT 0\n'
+        # バイト数が不正な TCL には応答してから接続を切る（最後の RUN は処理しない）
+        errFrame '入力: 不正な要求です。 (要求: "TCL p abc")'
+    } > $dir/expected
+    cmp $dir/expected $dir/reply
+    rm -rf $dir
+else
+    echo "WARNING: nc doesn't support UNIX domain sockets (-U, -N)"
+fi
 echo "OK"